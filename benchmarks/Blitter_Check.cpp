@@ -0,0 +1,458 @@
+// Este código es de dominio público.
+
+/* Comprobación aleatoria de argb::Blitter::blit_slice() y de Sprite_Batch. Cada caso dibuja un
+ * rectángulo de un atlas con una posición, un rectángulo de recorte, una transformación y una
+ * mezcla al azar (incluidas coordenadas muy alejadas del color buffer, por delante y por detrás)
+ * y compara el resultado, byte a byte, con el de una versión de referencia que mezcla los
+ * píxeles de uno en uno. Así no pasa desapercibido un error al trasladar los márgenes recortados
+ * del destino a los lados del slice que cada transformación lleva hasta ellos.
+ *
+ * Después se dibujan lotes de slices al azar con Sprite_Batch, con distintas alturas de franja,
+ * sin thread pool y con él, y se comparan con los mismos slices dibujados uno a uno por la
+ * referencia, lo que comprueba también que cada franja respeta el orden de los sprites.
+ *
+ * Uso: Blitter_Check [opciones]
+ *
+ *   --count casos     Slices sueltos por formato de color (3000 por defecto). Se dibujan además
+ *                     count / 30 lotes de hasta 200 slices.
+ *   --seed semilla    Semilla de los números aleatorios (1 por defecto).
+ *   --tier nivel      Limita los kernels de mezcla a scalar, sse2, avx2 o avx512.
+ *
+ * El programa termina con un código distinto de 0 si algún caso no coincide.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "Blitter.hpp"
+#include "cpu_dispatch.hpp"
+#include "Sprite_Batch.hpp"
+#include "Thread_Pool.hpp"
+
+namespace
+{
+
+    // Mezclas que se prueban. Las que usan alpha solo existen para los formatos de 4 x 8 bits:
+
+    enum class Blend
+    {
+        REPLACE,
+        HALF,
+        SOURCE_OVER,
+        PREMULTIPLIED,
+        ADDITIVE,
+        MULTIPLY
+    };
+
+    template< class COLOR >
+    constexpr unsigned blend_count ()
+    {
+        return argb::internal::is_alpha8888< COLOR > () ? 6 : 2;
+    }
+
+    template< class COLOR >
+    argb::blend_function< COLOR > blend_function_of (Blend blend)
+    {
+        switch (blend)
+        {
+            case Blend::REPLACE: return argb::blend_replace< COLOR >;
+            case Blend::HALF:    return argb::blend_half   < COLOR >;
+
+            default:
+
+                if constexpr (argb::internal::is_alpha8888< COLOR > ())
+                {
+                    switch (blend)
+                    {
+                        case Blend::SOURCE_OVER:   return argb::blend_source_over  < COLOR >;
+                        case Blend::PREMULTIPLIED: return argb::blend_premultiplied< COLOR >;
+                        case Blend::ADDITIVE:      return argb::blend_additive     < COLOR >;
+                        default:                   return argb::blend_multiply     < COLOR >;
+                    }
+                }
+
+                return argb::blend_replace< COLOR >;
+        }
+    }
+
+    // Un blit con todos sus parámetros:
+
+    template< class COLOR >
+    struct Slice
+    {
+        using Transform = typename argb::Blitter< COLOR >::Transform;
+
+        int       x, y;                                 // Posición en el destino
+        unsigned  left, top, width, height;             // Rectángulo del atlas
+        Blend     blend;
+        Transform transform;
+    };
+
+    // Los números aleatorios se toman directamente de mt19937, como en el benchmark, para que los
+    // casos de una semilla sean los mismos con cualquier biblioteca estándar:
+
+    int random_int (std::mt19937 & random, int min, int max)
+    {
+        return min + int(random () % uint32_t(max - min + 1));
+    }
+
+    template< class COLOR >
+    void fill_randomly (argb::Color_Buffer< COLOR > & buffer, std::mt19937 & random)
+    {
+        uint8_t * bytes = reinterpret_cast< uint8_t * >(buffer.colors ());
+        size_t    count = size_t(buffer.get_pitch ()) * buffer.get_height () * sizeof(COLOR);
+
+        while (count--) *bytes++ = uint8_t(random ());
+    }
+
+    // Coordenada del destino: casi siempre cerca del color buffer, pero a veces en los extremos
+    // del rango de int para comprobar que los cálculos del recorte no desbordan:
+
+    int random_coordinate (std::mt19937 & random, int size)
+    {
+        switch (random () % 16)
+        {
+            case 0:  return INT_MIN + random_int (random, 0, 64);
+            case 1:  return INT_MAX - random_int (random, 0, 64);
+            default: return random_int (random, -80, size + 16);
+        }
+    }
+
+    template< class COLOR >
+    Slice< COLOR > random_slice (const argb::Color_Buffer< COLOR > & atlas, int target_width, int target_height, std::mt19937 & random)
+    {
+        using Transform = typename Slice< COLOR >::Transform;
+
+        Slice< COLOR > slice;
+
+        slice.width     = unsigned(random_int (random, 1, int(atlas.get_width  ())));
+        slice.height    = unsigned(random_int (random, 1, int(atlas.get_height ())));
+        slice.left      = unsigned(random_int (random, 0, int(atlas.get_width  () - slice.width )));
+        slice.top       = unsigned(random_int (random, 0, int(atlas.get_height () - slice.height)));
+        slice.x         = random_coordinate (random, target_width );
+        slice.y         = random_coordinate (random, target_height);
+        slice.blend     = Blend    (random () % blend_count< COLOR > ());
+        slice.transform = Transform(random () % 6);
+
+        return slice;
+    }
+
+    /** Versión de referencia de blit_slice(): lleva cada píxel del slice a su posición en el
+      * destino según la transformación y lo mezcla si cae dentro del rectángulo de recorte
+      * [clip_left, clip_right) x [clip_top, clip_bottom), que ya debe estar dentro de target.
+      */
+    template< class COLOR >
+    void reference_blit_slice
+    (
+        argb::Color_Buffer< COLOR >       & target,
+        const argb::Color_Buffer< COLOR > & atlas,
+        const Slice< COLOR >              & slice,
+        int clip_left, int clip_top, int clip_right, int clip_bottom
+    )
+    {
+        using Transform = typename Slice< COLOR >::Transform;
+
+        const argb::blend_function< COLOR > blend = blend_function_of< COLOR > (slice.blend);
+
+        const int64_t w = slice.width;
+        const int64_t h = slice.height;
+
+        for (int64_t sy = 0; sy < h; ++sy)
+        {
+            for (int64_t sx = 0; sx < w; ++sx)
+            {
+                int64_t dx, dy;
+
+                switch (slice.transform)
+                {
+                    case Transform::FLIP_HORIZONTAL: dx = w - 1 - sx; dy = sy;         break;
+                    case Transform::FLIP_VERTICAL:   dx = sx;         dy = h - 1 - sy; break;
+                    case Transform::ROTATE_180:      dx = w - 1 - sx; dy = h - 1 - sy; break;
+                    case Transform::ROTATE_90:       dx = h - 1 - sy; dy = sx;         break;
+                    case Transform::ROTATE_270:      dx = sy;         dy = w - 1 - sx; break;
+                    default:                         dx = sx;         dy = sy;
+                }
+
+                dx += slice.x;
+                dy += slice.y;
+
+                if (dx < clip_left || dx >= clip_right || dy < clip_top || dy >= clip_bottom) continue;
+
+                blend
+                (
+                    target.colors ()[size_t(dy) * target.get_pitch () + size_t(dx)],
+                    atlas .colors ()[size_t(slice.top + sy) * atlas.get_pitch () + slice.left + size_t(sx)]
+                );
+            }
+        }
+    }
+
+    template< class COLOR >
+    void blit_slice (argb::Blitter< COLOR > & blitter, const argb::Color_Buffer< COLOR > & atlas, const Slice< COLOR > & slice)
+    {
+        auto blit = [&] (auto blend_function)
+        {
+            blitter.template blit_slice< decltype(blend_function)::value >
+            (
+                slice.x, slice.y, slice.left, slice.top, slice.width, slice.height, atlas, slice.transform
+            );
+        };
+
+        using Function = argb::blend_function< COLOR >;
+
+        switch (slice.blend)
+        {
+            case Blend::REPLACE: blit (std::integral_constant< Function, argb::blend_replace< COLOR > > ()); break;
+            case Blend::HALF:    blit (std::integral_constant< Function, argb::blend_half   < COLOR > > ()); break;
+
+            default:
+
+                if constexpr (argb::internal::is_alpha8888< COLOR > ())
+                {
+                    switch (slice.blend)
+                    {
+                        case Blend::SOURCE_OVER:   blit (std::integral_constant< Function, argb::blend_source_over  < COLOR > > ()); break;
+                        case Blend::PREMULTIPLIED: blit (std::integral_constant< Function, argb::blend_premultiplied< COLOR > > ()); break;
+                        case Blend::ADDITIVE:      blit (std::integral_constant< Function, argb::blend_additive     < COLOR > > ()); break;
+                        default:                   blit (std::integral_constant< Function, argb::blend_multiply     < COLOR > > ());
+                    }
+                }
+        }
+    }
+
+    // Compara solo los píxeles visibles (el relleno de las filas no se escribe nunca):
+
+    template< class COLOR >
+    bool same_pixels (const argb::Color_Buffer< COLOR > & a, const argb::Color_Buffer< COLOR > & b)
+    {
+        for (unsigned y = 0; y < a.get_height (); ++y)
+        {
+            const COLOR * row_a = a.colors () + size_t(y) * a.get_pitch ();
+            const COLOR * row_b = b.colors () + size_t(y) * b.get_pitch ();
+
+            if (std::memcmp (row_a, row_b, a.get_width () * sizeof(COLOR)) != 0) return false;
+        }
+
+        return true;
+    }
+
+    /** Dibuja count slices al azar, cada uno sobre una copia del destino, con un rectángulo de
+      * recorte también al azar (que puede salirse del color buffer o quedar vacío). El destino
+      * tiene filas con relleno para que el pitch no coincida con el ancho. Devuelve el número de
+      * casos que no coinciden con la referencia.
+      */
+    template< class COLOR >
+    unsigned check_slices (const char * format, unsigned count, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+
+        argb::Color_Buffer< COLOR > atlas (67, 45);
+        argb::Color_Buffer< COLOR > target(93, 71, argb::Allocation_Policy::padded ());
+
+        fill_randomly (atlas,  random);
+        fill_randomly (target, random);
+
+        const int width  = int(target.get_width  ());
+        const int height = int(target.get_height ());
+
+        unsigned mismatches = 0;
+
+        for (unsigned index = 0; index < count; ++index)
+        {
+            const Slice< COLOR > slice = random_slice (atlas, width, height, random);
+
+            int clip_left   = random_int (random, -8, width  / 2);
+            int clip_top    = random_int (random, -8, height / 2);
+            int clip_right  = random_int (random, width  / 2, width  + 8);
+            int clip_bottom = random_int (random, height / 2, height + 8);
+
+            if (random () % 4 == 0) std::swap (clip_left, clip_right);
+
+            argb::Color_Buffer< COLOR > result   (target);
+            argb::Color_Buffer< COLOR > reference(target);
+
+            argb::Blitter< COLOR > blitter(result);
+
+            blitter.set_clip (clip_left, clip_top, clip_right, clip_bottom);
+
+            blit_slice (blitter, atlas, slice);
+
+            reference_blit_slice
+            (
+                reference, atlas, slice,
+                std::max (clip_left, 0), std::max (clip_top, 0), std::min (clip_right, width), std::min (clip_bottom, height)
+            );
+
+            if (!same_pixels (result, reference))
+            {
+                if (mismatches++ < 8)
+                {
+                    std::printf
+                    (
+                        "  mismatch: %s slice %u (%u, %u, %u x %u) at (%d, %d), blend %d, transform %d, clip [%d, %d) x [%d, %d)\n",
+                        format, index, slice.left, slice.top, slice.width, slice.height, slice.x, slice.y,
+                        int(slice.blend), int(slice.transform), clip_left, clip_right, clip_top, clip_bottom
+                    );
+                }
+            }
+        }
+
+        std::printf ("%-10s %6u slices  %u mismatches\n", format, count, mismatches);
+
+        return mismatches;
+    }
+
+    template< class COLOR >
+    typename example::Sprite_Batch< COLOR >::Blend_Mode blend_mode_of (Blend blend)
+    {
+        using Blend_Mode = typename example::Sprite_Batch< COLOR >::Blend_Mode;
+
+        switch (blend)
+        {
+            case Blend::HALF:          return Blend_Mode::HALF;
+            case Blend::SOURCE_OVER:   return Blend_Mode::SOURCE_OVER;
+            case Blend::PREMULTIPLIED: return Blend_Mode::PREMULTIPLIED;
+            case Blend::ADDITIVE:      return Blend_Mode::ADDITIVE;
+            case Blend::MULTIPLY:      return Blend_Mode::MULTIPLY;
+            default:                   return Blend_Mode::REPLACE;
+        }
+    }
+
+    /** Dibuja count lotes de slices al azar con Sprite_Batch, con una altura de franja también al
+      * azar, y compara cada lote con sus slices dibujados uno a uno por la referencia, en el
+      * orden en el que se añadieron. Cada lote se dibuja sin thread pool y con él. Los slices se
+      * concentran en la parte alta del destino para que se solapen mucho y el orden importe.
+      */
+    template< class COLOR >
+    unsigned check_batches (const char * format, unsigned count, uint32_t seed, example::Thread_Pool & pool)
+    {
+        std::mt19937 random(seed);
+
+        argb::Color_Buffer< COLOR > atlas (67, 45);
+        argb::Color_Buffer< COLOR > target(93, 71, argb::Allocation_Policy::padded ());
+
+        fill_randomly (atlas,  random);
+        fill_randomly (target, random);
+
+        const int width  = int(target.get_width  ());
+        const int height = int(target.get_height ());
+
+        unsigned mismatches = 0;
+
+        for (unsigned index = 0; index < count; ++index)
+        {
+            const unsigned band_height = unsigned(random_int (random, 1, 80));
+            const unsigned slice_count = unsigned(random_int (random, 1, 200));
+
+            example::Sprite_Batch< COLOR > batch(band_height);
+
+            argb::Color_Buffer< COLOR > reference(target);
+
+            for (unsigned i = 0; i < slice_count; ++i)
+            {
+                const Slice< COLOR > slice = random_slice (atlas, width, height / 2, random);
+
+                batch.add (atlas, slice.x, slice.y, slice.left, slice.top, slice.width, slice.height, blend_mode_of< COLOR > (slice.blend), slice.transform);
+
+                reference_blit_slice (reference, atlas, slice, 0, 0, width, height);
+            }
+
+            for (example::Thread_Pool * batch_pool : { (example::Thread_Pool *)nullptr, &pool })
+            {
+                argb::Color_Buffer< COLOR > result(target);
+
+                batch.draw (result, batch_pool);
+
+                if (!same_pixels (result, reference))
+                {
+                    if (mismatches++ < 8)
+                    {
+                        std::printf
+                        (
+                            "  mismatch: %s batch %u (%u slices, bands of %u rows) %s thread pool\n",
+                            format, index, slice_count, band_height, batch_pool ? "with" : "without"
+                        );
+                    }
+                }
+            }
+        }
+
+        std::printf ("%-10s %6u batches %u mismatches\n", format, count, mismatches);
+
+        return mismatches;
+    }
+
+}
+
+int main (int argc, char * argv[])
+{
+    unsigned count = 3000;
+    uint32_t seed  = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *      value  = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (value == nullptr)
+        {
+            std::fprintf (stderr, "missing value for %s\n", option.c_str ());
+            return 2;
+        }
+
+        if (option == "--count") count = unsigned(std::strtoul (value, nullptr, 10)); else
+        if (option == "--seed" ) seed  = uint32_t(std::strtoul (value, nullptr, 10)); else
+        if (option == "--tier")
+        {
+            const argb::Cpu_Tier tiers[] = { argb::Cpu_Tier::SCALAR, argb::Cpu_Tier::SSE2, argb::Cpu_Tier::AVX2, argb::Cpu_Tier::AVX512 };
+            const argb::Cpu_Tier * tier  = std::find_if
+            (
+                std::begin (tiers), std::end (tiers),
+                [value] (argb::Cpu_Tier candidate) { return std::strcmp (value, argb::get_cpu_tier_name (candidate)) == 0; }
+            );
+
+            if (tier == std::end (tiers))
+            {
+                std::fprintf (stderr, "unknown tier %s (expected scalar, sse2, avx2 or avx512)\n", value);
+                return 2;
+            }
+
+            argb::force_cpu_tier (*tier);
+        }
+        else
+        {
+            std::fprintf (stderr, "unknown option %s\n", option.c_str ());
+            return 2;
+        }
+
+        ++i;
+    }
+
+    std::printf ("cpu tier: %s, seed %u\n\n", argb::get_cpu_tier_name (argb::get_cpu_tier ()), unsigned(seed));
+
+    unsigned mismatches = 0;
+
+    mismatches += check_slices< argb::Rgba8888 > ("rgba8888", count, seed);
+    mismatches += check_slices< argb::Argb8888 > ("argb8888", count, seed);
+    mismatches += check_slices< argb::Rgb888   > ("rgb888",   count, seed);
+    mismatches += check_slices< argb::Rgb565   > ("rgb565",   count, seed);
+
+    // Con al menos 4 hilos aunque la CPU tenga menos núcleos, para que las franjas se repartan:
+
+    example::Thread_Pool pool(std::max (std::thread::hardware_concurrency (), 4u));
+
+    mismatches += check_batches< argb::Rgba8888 > ("rgba8888", count / 30, seed, pool);
+    mismatches += check_batches< argb::Argb8888 > ("argb8888", count / 30, seed, pool);
+    mismatches += check_batches< argb::Rgb888   > ("rgb888",   count / 30, seed, pool);
+    mismatches += check_batches< argb::Rgb565   > ("rgb565",   count / 30, seed, pool);
+
+    return mismatches ? 1 : 0;
+}
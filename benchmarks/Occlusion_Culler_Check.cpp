@@ -0,0 +1,113 @@
+// Este código es de dominio público.
+
+/* Casos fijos de Occlusion_Culler. Cada uno añade unos oclusores, construye el z-buffer (sin
+ * thread pool y con él) y comprueba si una caja se da por visible. Los casos que esperan una
+ * caja visible son los que importan: si el culler la descartase, un objeto que se ve dejaría de
+ * dibujarse.
+ *
+ * Uso: Occlusion_Culler_Check
+ *
+ * El programa termina con un código distinto de 0 si algún caso no da el resultado esperado.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "Occlusion_Culler.hpp"
+#include "Thread_Pool.hpp"
+
+namespace
+{
+
+    using namespace example;
+
+    // Malla oclusora en coordenadas de cámara (la cámara mira hacia -z):
+
+    struct Occluder
+    {
+        std::vector< Vector3f > vertices;
+        std::vector< uint32_t > indices;
+    };
+
+    struct Case
+    {
+        const char *           name;
+        std::vector< Occluder > occluders;
+        Vector3f               box_min;
+        Vector3f               box_max;
+        bool                   visible;                 // Resultado esperado
+    };
+
+    // Rectángulo [x0, x1] x [y0, y1] a la profundidad z, con dos triángulos:
+
+    Occluder wall (float x0, float y0, float x1, float y1, float z)
+    {
+        return { { Vector3f(x0, y0, z), Vector3f(x1, y0, z), Vector3f(x1, y1, z), Vector3f(x0, y1, z) }, { 0, 1, 2, 0, 2, 3 } };
+    }
+
+    std::vector< Case > build_cases ()
+    {
+        std::vector< Case > cases;
+
+        cases.push_back ({ "box behind a wall",           { wall (-4.f, -4.f, 4.f, 4.f, -5.f) }, Vector3f(-.5f, -.5f, -9.f), Vector3f(.5f, .5f, -8.f), false });
+        cases.push_back ({ "box in front of a wall",      { wall (-4.f, -4.f, 4.f, 4.f, -5.f) }, Vector3f(-.5f, -.5f, -4.f), Vector3f(.5f, .5f, -3.f), true  });
+        cases.push_back ({ "box beside a wall",           { wall (-4.f, -4.f, 0.f, 4.f, -5.f) }, Vector3f( 2.f, -.5f, -9.f), Vector3f(3.f, .5f, -8.f), true  });
+        cases.push_back ({ "box crossing the near plane", { wall (-4.f, -4.f, 4.f, 4.f, -5.f) }, Vector3f(-.5f, -.5f, -9.f), Vector3f(.5f, .5f,  .5f), true  });
+
+        // Triángulo con un vértice delante del plano cercano (a 0.2) y dos entre él y la cámara
+        // (a 0.05). Proyectado tal cual cubre el centro de la pantalla con la profundidad del
+        // vértice de delante, pero la parte que se ve tras recortarlo queda por encima del centro,
+        // así que la caja de detrás, algo por debajo, se ve:
+
+        cases.push_back
+        ({
+            "box behind a near-crossing occluder",
+            { { { Vector3f(0.f, .1f, -.2f), Vector3f(-.05f, -.05f, -.05f), Vector3f(.05f, -.05f, -.05f) }, { 0, 1, 2 } } },
+            Vector3f(-.1f, -1.3f, -5.1f), Vector3f(.1f, -1.1f, -4.9f),
+            true
+        });
+
+        return cases;
+    }
+
+}
+
+int main ()
+{
+    const Matrix44 projection = perspective (1.0472f, .1f, 100.f, 2.f);   // 60 grados, 2:1
+    const Matrix44 identity(1.f);
+
+    Thread_Pool pool(4);
+
+    unsigned failures = 0;
+
+    for (const Case & test : build_cases ())
+    {
+        for (Thread_Pool * thread_pool : { (Thread_Pool *)nullptr, &pool })
+        {
+            Occlusion_Culler culler;
+
+            culler.begin_frame (projection);
+
+            for (const Occluder & occluder : test.occluders)
+            {
+                culler.add_occluder (identity, occluder.vertices.data (), occluder.vertices.size (), occluder.indices.data (), occluder.indices.size ());
+            }
+
+            culler.build (thread_pool);
+
+            const bool visible = culler.is_visible (identity, test.box_min, test.box_max);
+
+            if (visible != test.visible) failures++;
+
+            std::printf
+            (
+                "%-40s %-16s %s (%s)\n",
+                test.name, thread_pool ? "with pool" : "without pool", visible ? "visible" : "hidden ",
+                visible == test.visible ? "ok" : "FAILED"
+            );
+        }
+    }
+
+    return failures ? 1 : 0;
+}
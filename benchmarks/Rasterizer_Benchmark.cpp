@@ -0,0 +1,748 @@
+// Este código es de dominio público.
+
+/* Benchmark del rasterizer por software. Cada caso combina una carga sintética, una resolución,
+ * un formato de color buffer y un motor de relleno, y mide los millones de triángulos y de
+ * píxeles (fragmentos que pasan el test de profundidad) por segundo. Al terminar cada caso se
+ * calcula un hash de la imagen final que se compara con el de un archivo de referencia, de modo
+ * que una optimización no pueda cambiar píxeles sin que se note.
+ *
+ * A 720p y con Rgba8888 hay además casos con MSAA, con el visibility buffer y con cada uno de los
+ * demás formatos de profundidad, cuyo nombre termina en msaa, visibility, unorm16, unorm24, float
+ * o float_reversed.
+ *
+ * Uso: Rasterizer_Benchmark [opciones]
+ *
+ *   --filter texto            Solo ejecuta los casos cuyo nombre contiene texto.
+ *   --min-time segundos       Tiempo mínimo de medida de cada caso (0.25 por defecto). Con 0 se
+ *                             dibuja un único frame, lo que basta para comprobar las imágenes.
+ *   --tier nivel              Limita los kernels a scalar, sse2, avx2 o avx512 (cualquier otro
+ *                             nombre es un error).
+ *   --json archivo            Guarda los resultados en JSON ("-" para la salida estándar).
+ *   --golden archivo          Compara el hash de cada imagen con el del archivo.
+ *   --update-golden archivo   Escribe en el archivo los hashes de los casos ejecutados.
+ *   --dump carpeta            Guarda como PPM las imágenes que no coinciden con la referencia.
+ *
+ * El programa termina con un código distinto de 0 si alguna imagen no coincide. Los hashes de
+ * referencia están en benchmarks/golden/rasterizer.txt, con una línea "caso hash" por caso.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "cpu_dispatch.hpp"
+#include "Rasterizer.hpp"
+
+namespace
+{
+
+    using namespace example;
+
+    // Polígonos de una carga, en coordenadas de pantalla y ya preparados para draw_indexed():
+
+    struct Scene
+    {
+        std::vector< Point4i > vertices;
+        Index_Buffer           indices;
+        std::vector< float   > uv;                      // Coordenadas de textura (2 por vértice)
+        std::vector< float   > inverse_w;
+        bool                   textured = false;
+    };
+
+    struct Resolution
+    {
+        const char * name;
+        int          width;
+        int          height;
+    };
+
+    struct Options
+    {
+        std::string filter;
+        double      min_time = 0.25;
+        std::string json_path;
+        std::string golden_path;
+        std::string update_golden_path;
+        std::string dump_path;
+    };
+
+    // Funciones del rasterizer que se activan en un caso además del motor de relleno:
+
+    enum class Mode
+    {
+        PLAIN,
+        MSAA,                                           // Muestras 4x y resolve_msaa()
+        VISIBILITY                                      // Visibility buffer y resolve_visibility()
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string workload;
+        std::string resolution;
+        std::string format;
+        std::string engine;
+        std::string variant;                            // Vacío en los casos básicos
+        int         width;
+        int         height;
+        size_t      triangles;
+        uint64_t    pixels;
+        unsigned    frames;
+        double      seconds;
+        uint64_t    hash;
+        std::string golden;                             // match, mismatch, missing o unchecked
+    };
+
+    typedef Scene (* Scene_Builder) (int width, int height, std::mt19937 & random);
+
+    struct Workload
+    {
+        const char  * name;
+        Scene_Builder build;
+    };
+
+    // Los números aleatorios se toman directamente de mt19937, cuya secuencia es la misma con
+    // cualquier biblioteca estándar (las distribuciones no lo garantizan):
+
+    int random_int (std::mt19937 & random, int min, int max)
+    {
+        return min + int(random () % uint32_t(max - min + 1));
+    }
+
+    float random_float (std::mt19937 & random)
+    {
+        return float(random () % 65536) / 65536.f;
+    }
+
+    int random_depth (std::mt19937 & random)
+    {
+        return random_int (random, -100000000, 100000000);
+    }
+
+    void add_triangle (Scene & scene, int cx, int cy, int radius, int z, std::mt19937 & random)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            scene.indices .push_back (int(scene.vertices.size ()));
+            scene.vertices.push_back (Point4i(cx + random_int (random, -radius, radius), cy + random_int (random, -radius, radius), z, 1));
+        }
+    }
+
+    // Muchos triángulos diminutos (de unos 3 píxeles), en los que pesa sobre todo la preparación
+    // de cada triángulo:
+
+    Scene build_small_triangles (int width, int height, std::mt19937 & random)
+    {
+        Scene scene;
+
+        for (int count = width * height / 8; count > 0; --count)
+        {
+            add_triangle (scene, random_int (random, 0, width - 1), random_int (random, 0, height - 1), 3, random_depth (random), random);
+        }
+
+        return scene;
+    }
+
+    // 64 triángulos grandes que en total cubren la pantalla algo más de una vez:
+
+    Scene build_large_triangles (int width, int height, std::mt19937 & random)
+    {
+        Scene scene;
+
+        const int radius = std::min (width, height) / 2;
+
+        for (int count = 0; count < 64; ++count)
+        {
+            add_triangle (scene, random_int (random, 0, width - 1), random_int (random, 0, height - 1), radius, random_depth (random), random);
+        }
+
+        return scene;
+    }
+
+    // 32 capas de quads a pantalla completa a profundidades aleatorias, con lo que una parte de
+    // los fragmentos pasa el test de profundidad y el resto se descarta:
+
+    Scene build_overdraw (int width, int height, std::mt19937 & random)
+    {
+        Scene scene;
+
+        for (int layer = 0; layer < 32; ++layer)
+        {
+            const int z     = random_depth (random);
+            const int first = int(scene.vertices.size ());
+
+            scene.vertices.push_back (Point4i(0,     0,      z, 1));
+            scene.vertices.push_back (Point4i(width, 0,      z, 1));
+            scene.vertices.push_back (Point4i(width, height, z, 1));
+            scene.vertices.push_back (Point4i(0,     height, z, 1));
+
+            for (int index : { 0, 1, 2, 0, 2, 3 }) scene.indices.push_back (first + index);
+        }
+
+        return scene;
+    }
+
+    // Triángulos de unos 40 píxeles con coordenadas de textura en perspectiva que en total cubren
+    // la pantalla unas dos veces:
+
+    Scene build_textured (int width, int height, std::mt19937 & random)
+    {
+        Scene scene;
+
+        scene.textured = true;
+
+        for (int count = width * height / 20; count > 0; --count)
+        {
+            add_triangle (scene, random_int (random, 0, width - 1), random_int (random, 0, height - 1), 12, random_depth (random), random);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                scene.uv       .push_back (random_float (random) * 4.f);
+                scene.uv       .push_back (random_float (random) * 4.f);
+                scene.inverse_w.push_back (0.25f + random_float (random));
+            }
+        }
+
+        return scene;
+    }
+
+    const Workload workloads[] =
+    {
+        { "small",    build_small_triangles },
+        { "large",    build_large_triangles },
+        { "overdraw", build_overdraw        },
+        { "textured", build_textured        },
+    };
+
+    const Resolution resolutions[] =
+    {
+        { "720p",  1280,  720 },
+        { "1080p", 1920, 1080 },
+        { "4k",    3840, 2160 },
+    };
+
+    // Hash FNV-1a de los píxeles, fila a fila para saltar el relleno:
+
+    template< class COLOR >
+    uint64_t hash_pixels (const argb::Color_Buffer< COLOR > & buffer)
+    {
+        const size_t row_size = size_t(buffer.get_width ()) * sizeof(COLOR);
+        uint64_t     hash     = 14695981039346656037ull;
+
+        for (unsigned y = 0; y < buffer.get_height (); ++y)
+        {
+            const uint8_t * bytes = reinterpret_cast< const uint8_t * >(buffer.row (y));
+
+            for (size_t i = 0; i < row_size; ++i)
+            {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+
+        return hash;
+    }
+
+    template< class COLOR >
+    void to_rgb888 (const COLOR & color, uint8_t rgb[3])
+    {
+        if constexpr (std::is_void< typename COLOR::Component_Type >::value)
+        {
+            rgb[0] = uint8_t(unsigned(color.red   ()) * 255 / COLOR::  red_traits::mask);
+            rgb[1] = uint8_t(unsigned(color.green ()) * 255 / COLOR::green_traits::mask);
+            rgb[2] = uint8_t(unsigned(color.blue  ()) * 255 / COLOR:: blue_traits::mask);
+        }
+        else
+        if constexpr (std::is_floating_point< typename COLOR::Component_Type >::value)
+        {
+            rgb[0] = uint8_t(std::max (0.f, std::min (float(color.red   ()), 1.f)) * 255.f + .5f);
+            rgb[1] = uint8_t(std::max (0.f, std::min (float(color.green ()), 1.f)) * 255.f + .5f);
+            rgb[2] = uint8_t(std::max (0.f, std::min (float(color.blue  ()), 1.f)) * 255.f + .5f);
+        }
+        else
+        {
+            rgb[0] = uint8_t(color.red   ());
+            rgb[1] = uint8_t(color.green ());
+            rgb[2] = uint8_t(color.blue  ());
+        }
+    }
+
+    template< class COLOR >
+    void save_ppm (const argb::Color_Buffer< COLOR > & buffer, const std::string & path)
+    {
+        std::ofstream file(path, std::ios::binary);
+
+        file << "P6\n" << buffer.get_width () << ' ' << buffer.get_height () << "\n255\n";
+
+        for (unsigned y = 0; y < buffer.get_height (); ++y)
+        {
+            const COLOR * colors = buffer.row (y);
+
+            for (unsigned x = 0; x < buffer.get_width (); ++x)
+            {
+                uint8_t rgb[3];
+                to_rgb888 (colors[x], rgb);
+                file.write (reinterpret_cast< const char * >(rgb), 3);
+            }
+        }
+    }
+
+    // El constructor con (r, g, b) no inicializa el alfa, lo que cambiaría el hash de una
+    // ejecución a otra. Aquí queda a 0:
+
+    template< class COLOR >
+    COLOR make_color (float red, float green, float blue)
+    {
+        COLOR color = COLOR();
+
+        color.set (red, green, blue);
+
+        return color;
+    }
+
+    // Imagen procedural de la textura, igual para todos los formatos:
+
+    template< class COLOR >
+    argb::Color_Buffer< COLOR > make_texture_image ()
+    {
+        argb::Color_Buffer< COLOR > image(256, 256);
+
+        for (unsigned y = 0; y < 256; ++y)
+        {
+            for (unsigned x = 0; x < 256; ++x)
+            {
+                const bool check = ((x >> 5) ^ (y >> 5)) & 1;
+
+                image.colors ()[y * 256 + x] = make_color< COLOR > (float(x) / 255.f, float(y) / 255.f, check ? 0.9f : 0.2f);
+            }
+        }
+
+        return image;
+    }
+
+    class Benchmark
+    {
+    private:
+
+        Options                           options;
+        Thread_Pool                       thread_pool;
+        std::map< std::string, uint64_t > golden;
+        std::vector< Result >             results;
+        unsigned                          mismatches = 0;
+
+    public:
+
+        Benchmark(const Options & options) : options(options)
+        {
+            if (!options.golden_path.empty ()) load_golden ();
+        }
+
+        // variant distingue los casos con un modo distinto de PLAIN o con un formato de
+        // profundidad distinto de Depth_Int32, y se añade al final de su nombre:
+
+        template< class COLOR, class DEPTH_FORMAT = Depth_Int32 >
+        void run_format
+        (
+            const char       * format,
+            const Workload   & workload,
+            const Resolution & resolution,
+            const Scene      & scene,
+            const char       * variant = "",
+            Mode               mode    = Mode::PLAIN
+        )
+        {
+            typedef argb::Color_Buffer< COLOR >              Color_Buffer;
+            typedef Rasterizer< Color_Buffer, DEPTH_FORMAT > Rasterizer;
+
+            static const char * const engines[] = { "scanline", "half_space", "half_space_binned" };
+
+            for (unsigned engine = 0; engine < 3; ++engine)
+            {
+                std::string name = std::string(workload.name) + '/' + resolution.name + '/' + format + '/' + engines[engine];
+
+                if (*variant) name += std::string("/") + variant;
+
+                if (name.find (options.filter) == std::string::npos) continue;
+
+                // Filas alineadas a líneas de caché, como las querrá cualquier aplicación que
+                // rellene el color buffer con varios hilos. Se borra antes de cada frame:
+
+                Color_Buffer color_buffer(unsigned(resolution.width), unsigned(resolution.height), argb::Allocation_Policy::padded ().uninitialized ());
+                Rasterizer   rasterizer  (color_buffer);
+
+                const Color_Buffer                   texture_image = make_texture_image< COLOR > ();
+                const typename Rasterizer::Texture   texture(texture_image);
+
+                rasterizer.set_fill_engine (engine == 0 ? Rasterizer::Fill_Engine::SCANLINE : Rasterizer::Fill_Engine::HALF_SPACE);
+                rasterizer.enable_backface_culling (false);
+                rasterizer.enable_fast_clear (true);
+                rasterizer.enable_msaa (mode == Mode::MSAA);
+                rasterizer.enable_visibility_buffer (mode == Mode::VISIBILITY);
+
+                if (scene.textured)
+                {
+                    rasterizer.set_vertex_attributes (scene.uv.data (), scene.inverse_w.data (), 2);
+                    rasterizer.set_texture (&texture, 0);
+                }
+
+                const bool binned = engine == 2;
+
+                // En el modo visibility buffer cada píxel cubierto se pinta con un color que solo
+                // depende del ID de su triángulo:
+
+                auto shade_visibility = [] (const typename Rasterizer::Visibility_Sample & sample, int , int )
+                {
+                    const uint32_t hash = sample.triangle_id * 2654435761u;
+
+                    return make_color< COLOR > (float(hash >> 24) / 255.f, float(hash >> 16 & 0xFF) / 255.f, float(hash >> 8 & 0xFF) / 255.f);
+                };
+
+                // Los índices se dibujan en 8 lotes de distinto color para que la imagen dependa
+                // del orden de dibujo:
+
+                auto draw_frame = [&] (bool binned)
+                {
+                    rasterizer.clear (make_color< COLOR > (0.1f, 0.2f, 0.3f));
+
+                    if (binned) rasterizer.begin_binning (thread_pool);
+
+                    const size_t triangle_count = scene.indices.size () / 3;
+
+                    for (size_t batch = 0; batch < 8; ++batch)
+                    {
+                        Index_Buffer indices
+                        (
+                            scene.indices.begin () + (triangle_count *  batch      / 8) * 3,
+                            scene.indices.begin () + (triangle_count * (batch + 1) / 8) * 3
+                        );
+
+                        rasterizer.set_color (make_color< COLOR > (float(batch + 1) / 8.f, float(7 - batch) / 8.f, 0.5f));
+                        rasterizer.draw_indexed (scene.vertices, indices);
+                    }
+
+                    if (binned) rasterizer.end_binning ();
+
+                    // Los resolve se reparten entre los hilos en los casos binned:
+
+                    Thread_Pool * resolve_pool = binned ? &thread_pool : nullptr;
+
+                    if (mode == Mode::MSAA      ) rasterizer.resolve_msaa (resolve_pool);
+                    if (mode == Mode::VISIBILITY) rasterizer.resolve_visibility (shade_visibility, resolve_pool);
+
+                    rasterizer.resolve_clear ();
+                };
+
+                Result result;
+
+                result.name       = name;
+                result.workload   = workload.name;
+                result.resolution = resolution.name;
+                result.format     = format;
+                result.engine     = engines[engine];
+                result.variant    = variant;
+                result.width      = resolution.width;
+                result.height     = resolution.height;
+                result.triangles  = scene.indices.size () / 3;
+
+                // Los fragmentos se cuentan en un frame inmediato sin medir, ya que las consultas
+                // no se admiten durante el binning (y así tampoco se mide su coste):
+
+                rasterizer.begin_query ();
+
+                draw_frame (false);
+
+                result.pixels = rasterizer.end_query ();
+
+                // Se repite el frame hasta superar el tiempo mínimo:
+
+                typedef std::chrono::steady_clock Clock;
+
+                const Clock::time_point start = Clock::now ();
+
+                result.frames  = 0;
+                result.seconds = 0;
+
+                do
+                {
+                    draw_frame (binned);
+
+                    result.frames++;
+                    result.seconds = std::chrono::duration< double >(Clock::now () - start).count ();
+                }
+                while (result.seconds < options.min_time);
+
+                result.hash   = hash_pixels (color_buffer);
+                result.golden = check_golden (name, result.hash);
+
+                if (result.golden == "mismatch" && !options.dump_path.empty ())
+                {
+                    std::string file = name;
+                    std::replace (file.begin (), file.end (), '/', '_');
+                    save_ppm (color_buffer, options.dump_path + '/' + file + ".ppm");
+                }
+
+                print (result);
+
+                results.push_back (result);
+            }
+        }
+
+        void run ()
+        {
+            std::printf ("cpu tier: %s\n\n", argb::get_cpu_tier_name (argb::get_cpu_tier ()));
+            std::printf ("%-56s %9s %10s %10s %9s  %s\n", "case", "frames", "Mtris/s", "Mpixels/s", "ms/frame", "golden");
+
+            for (const Workload & workload : workloads)
+            {
+                for (const Resolution & resolution : resolutions)
+                {
+                    std::mt19937 random(12345);
+
+                    const Scene scene = workload.build (resolution.width, resolution.height, random);
+
+                    run_format< argb::Rgb888   > ("rgb888",   workload, resolution, scene);
+                    run_format< argb::Bgr888   > ("bgr888",   workload, resolution, scene);
+                    run_format< argb::Rgba8888 > ("rgba8888", workload, resolution, scene);
+                    run_format< argb::Argb8888 > ("argb8888", workload, resolution, scene);
+                    run_format< argb::Rgb565   > ("rgb565",   workload, resolution, scene);
+                    run_format< argb::Rgb332   > ("rgb332",   workload, resolution, scene);
+                    run_format< argb::Rgbf     > ("rgbf",     workload, resolution, scene);
+                    run_format< argb::Rgbaf    > ("rgbaf",    workload, resolution, scene);
+
+                    // MSAA, visibility buffer y los demás formatos de profundidad, con un solo
+                    // formato de color y solo a 720p para que la compilación y la comprobación de
+                    // las imágenes no se alarguen demasiado:
+
+                    if (&resolution == &resolutions[0])
+                    {
+                        run_format< argb::Rgba8888                       > ("rgba8888", workload, resolution, scene, "msaa",       Mode::MSAA      );
+                        run_format< argb::Rgba8888                       > ("rgba8888", workload, resolution, scene, "visibility", Mode::VISIBILITY);
+                        run_format< argb::Rgba8888, Depth_Unorm16        > ("rgba8888", workload, resolution, scene, "unorm16"    );
+                        run_format< argb::Rgba8888, Depth_Unorm24        > ("rgba8888", workload, resolution, scene, "unorm24"    );
+                        run_format< argb::Rgba8888, Depth_Float          > ("rgba8888", workload, resolution, scene, "float"      );
+                        run_format< argb::Rgba8888, Depth_Float_Reversed > ("rgba8888", workload, resolution, scene, "float_reversed");
+                    }
+                }
+            }
+
+            if (!options.json_path.empty ()) save_json ();
+
+            if (!options.update_golden_path.empty ()) save_golden ();
+
+            if (mismatches) std::printf ("\n%u images differ from the golden hashes\n", mismatches);
+        }
+
+        unsigned get_mismatches () const
+        {
+            return mismatches;
+        }
+
+    private:
+
+        void load_golden ()
+        {
+            std::ifstream file(options.golden_path);
+            std::string   line;
+
+            while (std::getline (file, line))
+            {
+                std::istringstream fields(line);
+                std::string        name, hash;
+
+                if (fields >> name >> hash && name[0] != '#')
+                {
+                    golden[name] = std::strtoull (hash.c_str (), nullptr, 16);
+                }
+            }
+        }
+
+        std::string check_golden (const std::string & name, uint64_t hash)
+        {
+            if (options.golden_path.empty ()) return "unchecked";
+
+            auto entry = golden.find (name);
+
+            if (entry == golden.end ()) return "missing";
+            if (entry->second == hash ) return "match";
+
+            mismatches++;
+
+            return "mismatch";
+        }
+
+        void save_golden () const
+        {
+            // Se conservan las entradas de los casos que no se han ejecutado:
+
+            std::map< std::string, uint64_t > hashes = golden;
+
+            if (options.update_golden_path != options.golden_path)
+            {
+                std::ifstream file(options.update_golden_path);
+                std::string   line;
+
+                while (std::getline (file, line))
+                {
+                    std::istringstream fields(line);
+                    std::string        name, hash;
+
+                    if (fields >> name >> hash && name[0] != '#') hashes[name] = std::strtoull (hash.c_str (), nullptr, 16);
+                }
+            }
+
+            for (const Result & result : results) hashes[result.name] = result.hash;
+
+            std::ofstream file(options.update_golden_path);
+
+            file << "# Hashes FNV-1a de las imágenes de Rasterizer_Benchmark (caso hash)\n";
+
+            for (const auto & entry : hashes)
+            {
+                char hash[17];
+                std::snprintf (hash, sizeof(hash), "%016" PRIx64, entry.second);
+                file << entry.first << ' ' << hash << '\n';
+            }
+        }
+
+        static void print (const Result & result)
+        {
+            std::printf
+            (
+                "%-56s %9u %10.2f %10.1f %9.3f  %s\n",
+                result.name.c_str (),
+                result.frames,
+                double(result.triangles) * result.frames / result.seconds * 1e-6,
+                double(result.pixels   ) * result.frames / result.seconds * 1e-6,
+                result.seconds / result.frames * 1e3,
+                result.golden.c_str ()
+            );
+        }
+
+        // El JSON tiene siempre las mismas claves en el mismo orden para que se pueda comparar
+        // entre commits:
+
+        void save_json () const
+        {
+            std::ostringstream json;
+
+            json << "{\n";
+            json << "  \"benchmark\": \"rasterizer\",\n";
+            json << "  \"cpu_tier\": \"" << argb::get_cpu_tier_name (argb::get_cpu_tier ()) << "\",\n";
+            json << "  \"min_time\": " << options.min_time << ",\n";
+            json << "  \"cases\": [\n";
+
+            for (size_t i = 0; i < results.size (); ++i)
+            {
+                const Result & result = results[i];
+
+                char numbers[256];
+                char hash   [17];
+
+                std::snprintf
+                (
+                    numbers, sizeof(numbers),
+                    "\"frames\": %u, \"seconds\": %.6f, \"ms_per_frame\": %.4f, \"mtris_per_s\": %.3f, \"mpixels_per_s\": %.3f",
+                    result.frames,
+                    result.seconds,
+                    result.seconds / result.frames * 1e3,
+                    double(result.triangles) * result.frames / result.seconds * 1e-6,
+                    double(result.pixels   ) * result.frames / result.seconds * 1e-6
+                );
+
+                std::snprintf (hash, sizeof(hash), "%016" PRIx64, result.hash);
+
+                json << "    { \"name\": \""       << result.name       << "\", "
+                     <<        "\"workload\": \""   << result.workload   << "\", "
+                     <<        "\"resolution\": \"" << result.resolution << "\", "
+                     <<        "\"width\": "        << result.width      << ", "
+                     <<        "\"height\": "       << result.height     << ", "
+                     <<        "\"format\": \""     << result.format     << "\", "
+                     <<        "\"engine\": \""     << result.engine     << "\", "
+                     <<        "\"variant\": \""    << result.variant    << "\", "
+                     <<        "\"triangles\": "    << result.triangles  << ", "
+                     <<        "\"pixels\": "       << result.pixels     << ", "
+                     <<        numbers                                   << ", "
+                     <<        "\"hash\": \""       << hash              << "\", "
+                     <<        "\"golden\": \""     << result.golden     << "\" }"
+                     << (i + 1 < results.size () ? ",\n" : "\n");
+            }
+
+            json << "  ]\n}\n";
+
+            if (options.json_path == "-")
+                std::fputs (json.str ().c_str (), stdout);
+            else
+                std::ofstream(options.json_path) << json.str ();
+        }
+
+    };
+
+}
+
+int main (int argc, char * argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string option = argv[i];
+        const char *      value  = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (value == nullptr)
+        {
+            std::fprintf (stderr, "missing value for %s\n", option.c_str ());
+            return 2;
+        }
+
+        if (option == "--filter"       ) options.filter             = value; else
+        if (option == "--min-time"     ) options.min_time           = std::atof (value); else
+        if (option == "--json"         ) options.json_path          = value; else
+        if (option == "--golden"       ) options.golden_path        = value; else
+        if (option == "--update-golden") options.update_golden_path = value; else
+        if (option == "--dump"         ) options.dump_path          = value; else
+        if (option == "--tier")
+        {
+            // Un nombre desconocido se rechaza: si se tomara como escalar, una comprobación de las
+            // imágenes pasaría con los kernels que no son:
+
+            const argb::Cpu_Tier tiers[] = { argb::Cpu_Tier::SCALAR, argb::Cpu_Tier::SSE2, argb::Cpu_Tier::AVX2, argb::Cpu_Tier::AVX512 };
+            const argb::Cpu_Tier * tier  = std::find_if
+            (
+                std::begin (tiers), std::end (tiers),
+                [value] (argb::Cpu_Tier candidate) { return std::strcmp (value, argb::get_cpu_tier_name (candidate)) == 0; }
+            );
+
+            if (tier == std::end (tiers))
+            {
+                std::fprintf (stderr, "unknown tier %s (expected scalar, sse2, avx2 or avx512)\n", value);
+                return 2;
+            }
+
+            // La CPU puede no admitir el nivel pedido, en cuyo caso se usa el más alto que admite:
+
+            std::printf ("requested tier %s, using %s\n", value, argb::get_cpu_tier_name (argb::force_cpu_tier (*tier)));
+        }
+        else
+        {
+            std::fprintf (stderr, "unknown option %s\n", option.c_str ());
+            return 2;
+        }
+
+        ++i;
+    }
+
+    Benchmark benchmark(options);
+
+    benchmark.run ();
+
+    return benchmark.get_mismatches () ? 1 : 0;
+}
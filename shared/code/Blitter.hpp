@@ -7,7 +7,9 @@
 #ifndef ARGB_BLITTER_HEADER
 #define ARGB_BLITTER_HEADER
 
+    #include <algorithm>
     #include <cassert>
+    #include <cstdint>
     #include "Color_Buffer.hpp"
     #include "blend_functions.hpp"
     #include "blitter_transforms.hpp"
@@ -37,58 +39,192 @@
 
             Color_Buffer & color_buffer;
 
+            int            clip_left;               // Rectngulo [left, right) x [top, bottom)
+            int            clip_top;                // fuera del cual no se escribe
+            int            clip_right;
+            int            clip_bottom;
+
         public:
 
             Blitter(Color_Buffer & given_color_buffer) : color_buffer(given_color_buffer)
             {
+                reset_clip ();
+            }
+
+            /** Limita las escrituras al rectngulo [left, right) x [top, bottom), recortado a su
+              * vez contra el color buffer. Permite, por ejemplo, que varios hilos dibujen en
+              * franjas distintas del mismo color buffer, cada uno con su Blitter.
+              */
+            void set_clip (int left, int top, int right, int bottom)
+            {
+                clip_left   = std::max (left,   0);
+                clip_top    = std::max (top,    0);
+                clip_right  = std::min (right,  int(color_buffer.get_width  ()));
+                clip_bottom = std::min (bottom, int(color_buffer.get_height ()));
+            }
+
+            void reset_clip ()
+            {
+                set_clip (0, 0, int(color_buffer.get_width ()), int(color_buffer.get_height ()));
             }
 
+            /** Copia el bitmap en la posicin indicada del color buffer, mezclndolo con
+              * BLEND_FUNCTION y aplicndole TRANSFORM_FUNCTION. La parte que queda fuera del color
+              * buffer o del rectngulo de set_clip() (incluso con coordenadas negativas) se recorta.
+              */
             template
             <
                 blend_function< COLOR > BLEND_FUNCTION = blend_replace, 
-                blitter_transform::function< COLOR, BLEND_FUNCTION > = blit_normal< COLOR, BLEND_FUNCTION >
+                blitter_transform::function< COLOR, BLEND_FUNCTION > TRANSFORM_FUNCTION = blit_normal< COLOR, BLEND_FUNCTION >
             >
             void blit
             (
-                unsigned target_left_x,
-                unsigned target_top_y,
+                int target_left_x,
+                int target_top_y,
                 const Color_Buffer & bitmap
-            );
+            )
+            {
+                blit_slice< BLEND_FUNCTION, TRANSFORM_FUNCTION > (target_left_x, target_top_y, 0, 0, bitmap.get_width (), bitmap.get_height (), bitmap);
+            }
+
+            /** Igual que blit(), eligiendo la transformacin en tiempo de ejecucin. Con ROTATE_90
+              * y ROTATE_270 el bitmap ocupa en el destino height x width pxeles a partir de
+              * (target_left_x, target_top_y).
+              */
+            template< blend_function< COLOR > BLEND_FUNCTION = blend_replace >
+            void blit
+            (
+                int target_left_x,
+                int target_top_y,
+                const Color_Buffer & bitmap,
+                Transform transform
+            )
+            {
+                blit_slice< BLEND_FUNCTION > (target_left_x, target_top_y, 0, 0, bitmap.get_width (), bitmap.get_height (), bitmap, transform);
+            }
 
-            /*template< blend_function< COLOR > = blend_replace >
+            /** Copia solo el rectngulo (slice_left_x, slice_top_y, slice_width, slice_height) del
+              * bitmap, que debe quedar dentro de l. Se lee directamente del bitmap, sin copias
+              * intermedias, y se recorta como en blit(). Es la forma de
+              * dibujar los sprites, glifos o iconos de un atlas.
+              */
+            template
+            <
+                blend_function< COLOR > BLEND_FUNCTION = blend_replace,
+                blitter_transform::function< COLOR, BLEND_FUNCTION > TRANSFORM_FUNCTION = blit_normal< COLOR, BLEND_FUNCTION >
+            >
             void blit_slice
             (
-                unsigned target_left_x,
-                unsigned target_top_y,
+                int      target_left_x,
+                int      target_top_y,
                 unsigned slice_left_x,
                 unsigned slice_top_y,
                 unsigned slice_width,
                 unsigned slice_height,
                 const Color_Buffer & bitmap
-            );*/
+            );
+
+            template< blend_function< COLOR > BLEND_FUNCTION = blend_replace >
+            void blit_slice
+            (
+                int      target_left_x,
+                int      target_top_y,
+                unsigned slice_left_x,
+                unsigned slice_top_y,
+                unsigned slice_width,
+                unsigned slice_height,
+                const Color_Buffer & bitmap,
+                Transform transform
+            );
+
+        private:
+
+            // Transformacin que aplica TRANSFORM_FUNCTION, que determina cmo se recorta. Las
+            // funciones de transformacin propias se recortan como blit_normal. No es constexpr
+            // porque GCC no admite comparar direcciones de funciones en una expresin constante,
+            // pero al ser parmetros de plantilla el compilador resuelve igualmente la comparacin:
+
+            template< blend_function< COLOR > BLEND_FUNCTION, blitter_transform::function< COLOR, BLEND_FUNCTION > TRANSFORM_FUNCTION >
+            static Transform transform_of ()
+            {
+                if (TRANSFORM_FUNCTION == &blit_flip_horizontal < COLOR, BLEND_FUNCTION >) return Transform::FLIP_HORIZONTAL;
+                if (TRANSFORM_FUNCTION == &blit_flip_vertical   < COLOR, BLEND_FUNCTION >) return Transform::FLIP_VERTICAL;
+                if (TRANSFORM_FUNCTION == &blit_rotate_90       < COLOR, BLEND_FUNCTION >) return Transform::ROTATE_90;
+                if (TRANSFORM_FUNCTION == &blit_rotate_180      < COLOR, BLEND_FUNCTION >) return Transform::ROTATE_180;
+                if (TRANSFORM_FUNCTION == &blit_rotate_270      < COLOR, BLEND_FUNCTION >) return Transform::ROTATE_270;
+
+                return Transform::NONE;
+            }
 
         };
 
         template< class COLOR >
         template< blend_function< COLOR > BLEND_FUNCTION, blitter_transform::function< COLOR, BLEND_FUNCTION > TRANSFORM_FUNCTION >
-        void Blitter< COLOR >::blit
+        void Blitter< COLOR >::blit_slice
         (
-            unsigned target_left_x, 
-            unsigned target_top_y, 
+            int      target_left_x,
+            int      target_top_y,
+            unsigned slice_left_x,
+            unsigned slice_top_y,
+            unsigned slice_width,
+            unsigned slice_height,
             const Color_Buffer & bitmap
         )
         {
+            assert(slice_left_x + slice_width  <= bitmap.get_width  ());
+            assert(slice_top_y  + slice_height <= bitmap.get_height ());
+
+            const Transform transform = transform_of< BLEND_FUNCTION, TRANSFORM_FUNCTION > ();
+            const bool      rotated   = transform == Transform::ROTATE_90 || transform == Transform::ROTATE_270;
+
+            // Rectngulo que ocupa el slice en el destino, recortado. Se calcula con 64 bits para
+            // que las coordenadas extremas no desborden:
+
+            const int64_t width  = rotated ? slice_height : slice_width;
+            const int64_t height = rotated ? slice_width  : slice_height;
+
+            const int64_t left   = std::max< int64_t > (target_left_x, clip_left);
+            const int64_t top    = std::max< int64_t > (target_top_y,  clip_top );
+            const int64_t right  = std::min< int64_t > (int64_t(target_left_x) + width,  clip_right );
+            const int64_t bottom = std::min< int64_t > (int64_t(target_top_y ) + height, clip_bottom);
+
+            if (left >= right || top >= bottom) return;
+
+            // Mrgenes recortados en cada lado del destino, relativos a la posicin del slice:
+
+            const unsigned margin_left   = unsigned(left - target_left_x);
+            const unsigned margin_top    = unsigned(top  - target_top_y );
+            const unsigned margin_right  = unsigned(int64_t(target_left_x) + width  - right );
+            const unsigned margin_bottom = unsigned(int64_t(target_top_y ) + height - bottom);
+
+            // Cada margen del destino recorta el lado del slice que acaba en l tras transformarlo:
+
+            unsigned source_left, source_top, source_right, source_bottom;
+
+            switch (transform)
+            {
+                case Transform::FLIP_HORIZONTAL: source_left = margin_right;  source_right = margin_left;   source_top = margin_top;    source_bottom = margin_bottom; break;
+                case Transform::FLIP_VERTICAL:   source_left = margin_left;   source_right = margin_right;  source_top = margin_bottom; source_bottom = margin_top;    break;
+                case Transform::ROTATE_180:      source_left = margin_right;  source_right = margin_left;   source_top = margin_bottom; source_bottom = margin_top;    break;
+                case Transform::ROTATE_90:       source_left = margin_top;    source_right = margin_bottom; source_top = margin_right;  source_bottom = margin_left;   break;
+                case Transform::ROTATE_270:      source_left = margin_bottom; source_right = margin_top;    source_top = margin_left;   source_bottom = margin_right;  break;
+                default:                         source_left = margin_left;   source_right = margin_right;  source_top = margin_top;    source_bottom = margin_bottom;
+            }
+
+            const unsigned source_width  = slice_width  - source_left - source_right;
+            const unsigned source_height = slice_height - source_top  - source_bottom;
+
             blitter_transform::Details< COLOR > details
             {
                 {
-                    bitmap.pixels     (),
-                    bitmap.get_width  (),
-                    bitmap.get_height (),
-                    0
+                    bitmap.colors     () + size_t(slice_top_y + source_top) * bitmap.get_pitch () + slice_left_x + source_left,
+                    source_width,
+                    source_height,
+                    bitmap.get_pitch  () - source_width
                 },
                 {
-                    color_buffer.pixels     () + color_buffer.get_width () * target_top_y + target_left_x,
-                    color_buffer.get_width  (),
+                    color_buffer.colors     () + size_t(top) * color_buffer.get_pitch () + size_t(left),
+                    color_buffer.get_pitch  (),
                     color_buffer.get_height ()
                 }
             };
@@ -96,6 +232,31 @@
             TRANSFORM_FUNCTION (details);
         }
 
+        template< class COLOR >
+        template< blend_function< COLOR > BLEND_FUNCTION >
+        void Blitter< COLOR >::blit_slice
+        (
+            int      target_left_x,
+            int      target_top_y,
+            unsigned slice_left_x,
+            unsigned slice_top_y,
+            unsigned slice_width,
+            unsigned slice_height,
+            const Color_Buffer & bitmap,
+            Transform transform
+        )
+        {
+            switch (transform)
+            {
+                case Transform::NONE:            blit_slice< BLEND_FUNCTION, blit_normal          < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+                case Transform::FLIP_HORIZONTAL: blit_slice< BLEND_FUNCTION, blit_flip_horizontal < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+                case Transform::FLIP_VERTICAL:   blit_slice< BLEND_FUNCTION, blit_flip_vertical   < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+                case Transform::ROTATE_90:       blit_slice< BLEND_FUNCTION, blit_rotate_90       < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+                case Transform::ROTATE_180:      blit_slice< BLEND_FUNCTION, blit_rotate_180      < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+                case Transform::ROTATE_270:      blit_slice< BLEND_FUNCTION, blit_rotate_270      < COLOR, BLEND_FUNCTION > > (target_left_x, target_top_y, slice_left_x, slice_top_y, slice_width, slice_height, bitmap); break;
+            }
+        }
+
     }
 
 #endif
@@ -9,12 +9,49 @@
 
     #include <algorithm>
     #include <cassert>
-    #include <vector>
+    #include <cstdint>
+    #include <cstring>
+    #include <memory>
+    #include <new>
     #include "Color.hpp"
+    #include "cpu_dispatch.hpp"
 
     namespace argb
     {
 
+        /** Indica cómo reserva la memoria un Color_Buffer. El inicio del buffer siempre queda
+          * alineado a 64 bytes (o a row_alignment si es mayor). Con row_alignment > 1 cada fila se
+          * alarga con un relleno hasta el siguiente múltiplo de row_alignment bytes, de modo que
+          * todas las filas empiezan en un límite de SIMD y dos hilos que escriben en filas
+          * distintas nunca comparten una línea de caché. Si initialize es false los píxeles se
+          * quedan sin inicializar, lo que ahorra una pasada completa por la memoria cuando el
+          * contenido se va a sobrescribir entero (por ejemplo, con un clear()).
+          */
+        struct Allocation_Policy
+        {
+            static constexpr unsigned cache_line_bytes = 64;
+
+            unsigned row_alignment = 1;             // En bytes, potencia de 2
+            bool     initialize    = true;
+
+            // Filas consecutivas sin relleno (el pitch coincide con el ancho):
+
+            static constexpr Allocation_Policy packed ()
+            {
+                return { 1, true };
+            }
+
+            static constexpr Allocation_Policy padded (unsigned row_alignment = cache_line_bytes)
+            {
+                return { row_alignment, true };
+            }
+
+            constexpr Allocation_Policy uninitialized () const
+            {
+                return { row_alignment, false };
+            }
+        };
+
         template< class COLOR >
         class Color_Buffer
         {
@@ -24,10 +61,6 @@
             using Color        = Color_Format;
             using Iterator     = Color *;
 
-        private:
-
-            using Buffer = std::vector< Color_Format >;
-
         public:
 
             static constexpr unsigned bits_per_color ()
@@ -35,40 +68,98 @@
                 return Color_Format::bits;
             }
 
+        private:
+
+            // Los spans se rellenan repitiendo un patrón de 48 bytes, que es múltiplo del tamaño de
+            // todos los formatos de Color.hpp (1, 2, 3, 4, 6, 8, 12 y 16 bytes):
+
+            static constexpr unsigned pattern_bytes  = 48;
+            static constexpr unsigned pattern_colors = pattern_bytes / sizeof(Color_Format);
+
+            static constexpr unsigned base_alignment = Allocation_Policy::cache_line_bytes;
+
+        private:
+
+            struct Aligned_Delete
+            {
+                size_t count;
+                size_t alignment;
+
+                void operator () (Color_Format * colors) const
+                {
+                    std::destroy_n (colors, count);
+                    ::operator delete (colors, std::align_val_t(alignment));
+                }
+            };
+
+            using Buffer = std::unique_ptr< Color_Format[], Aligned_Delete >;
+
         private:
 
             unsigned width;
             unsigned height;
-            unsigned size;
+            unsigned pitch;                     // Colores desde el inicio de una fila al de la siguiente
+            unsigned size;                      // width * height
+            unsigned storage_size;              // pitch * height
 
-            Buffer   buffer;
+            Allocation_Policy allocation;
 
-            Iterator start;
-            Iterator ending;
+            Buffer   buffer;
 
         public:
 
-            Color_Buffer(unsigned width, unsigned height)
+            Color_Buffer(unsigned width, unsigned height, Allocation_Policy allocation = Allocation_Policy::packed ())
+            :
+                width       (width                                        ),
+                height      (height                                       ),
+                pitch       (padded_pitch (width, allocation.row_alignment)),
+                size        (width * height                               ),
+                storage_size(pitch * height                               ),
+                allocation  (allocation                                   ),
+                buffer      (allocate (storage_size, allocation)          )
+            {
+            }
+
+            Color_Buffer(const Color_Buffer & other)
             :
-                width ( width          ),
-                height( height         ),
-                size  ( width * height ),
-                buffer( size           ),
-                start ( buffer.data () ),
-                ending( start + size   )
+                width       (other.width                                  ),
+                height      (other.height                                 ),
+                pitch       (other.pitch                                  ),
+                size        (other.size                                   ),
+                storage_size(other.storage_size                           ),
+                allocation  (other.allocation                             ),
+                buffer      (allocate (storage_size, allocation.uninitialized ()))
+            {
+                std::copy_n (other.colors (), storage_size, colors ());
+            }
+
+            Color_Buffer(Color_Buffer && ) = default;
+
+            Color_Buffer & operator = (const Color_Buffer & other)
             {
+                if (this != &other) *this = Color_Buffer(other);
+                return *this;
             }
 
+            Color_Buffer & operator = (Color_Buffer && ) = default;
+
         public:
 
-                  Color_Format * colors ()       { return buffer.data (); }
-            const Color_Format * colors () const { return buffer.data (); }
+                  Color_Format * colors ()       { return buffer.get (); }
+            const Color_Format * colors () const { return buffer.get (); }
 
-                  Iterator       begin  ()       { return start; }
-            const Iterator       begin  () const { return start; }
+            // Primer color de la fila y:
 
-                  Iterator       end    ()       { return ending; }
-            const Iterator       end    () const { return ending; }
+                  Color_Format * row (unsigned y)       { assert(y < height); return buffer.get () + size_t(y) * pitch; }
+            const Color_Format * row (unsigned y) const { assert(y < height); return buffer.get () + size_t(y) * pitch; }
+
+            // El recorrido con iteradores abarca todas las filas, incluido su relleno si lo hay:
+
+                  Iterator       begin  ()       { return buffer.get (); }
+            const Iterator       begin  () const { return buffer.get (); }
+
+                  Iterator       end    ()       { return buffer.get () + storage_size; }
+            const Iterator       end    () const { return buffer.get () + storage_size; }
 
             unsigned get_width () const
             {
@@ -80,28 +171,91 @@
                 return height;
             }
 
+            // Número de píxeles visibles (sin contar el relleno de las filas):
+
             unsigned get_size () const
             {
                 return size;
             }
 
+            /** Distancia en colores entre el inicio de dos filas consecutivas. Es mayor que el
+              * ancho cuando las filas llevan relleno, así que el píxel (x, y) está siempre en
+              * colors () + y * get_pitch () + x.
+              */
+            unsigned get_pitch () const
+            {
+                return pitch;
+            }
+
+            unsigned get_storage_size () const
+            {
+                return storage_size;
+            }
+
+            // Indica si las filas están seguidas sin relleno, como las espera OpenGL o un memcpy
+            // de la imagen completa:
+
+            bool is_packed () const
+            {
+                return pitch == width;
+            }
+
+            const Allocation_Policy & get_allocation_policy () const
+            {
+                return allocation;
+            }
+
         public:
 
             void clear (const Color & color)
             {
-                std::fill_n (buffer.data (), size, color);
+                fill (buffer.get (), storage_size, color);
+            }
+
+            /** Rellena con el mismo color count píxeles consecutivos a partir de offset, que se
+              * cuenta con el pitch del buffer (y * get_pitch () + x).
+              */
+            void fill_span (unsigned offset, unsigned count, const Color & color)
+            {
+                assert(offset + count <= storage_size);
+
+                fill (buffer.get () + offset, count, color);
+            }
+
+            /** Escribe el color en los píxeles offset + i cuyo bit i está activo en mask.
+              * Cada tramo de bits activos consecutivos se rellena de una vez.
+              */
+            void fill_span_masked (unsigned offset, uint32_t mask, const Color & color)
+            {
+                while (mask)
+                {
+                    unsigned first = lowest_bit (mask);
+                    uint32_t run   = ~(mask >> first);
+                    unsigned count = run ? lowest_bit (run) : 32 - first;
+
+                    assert(offset + first + count <= storage_size);
+
+                    if (count == 1)
+                        buffer[offset + first] = color;
+                    else
+                        fill (buffer.get () + offset + first, count, color);
+
+                    if (first + count == 32) break;
+
+                    mask &= ~0u << (first + count);
+                }
             }
 
             void set_color (unsigned x, unsigned y, Color & color)
             {
                 assert(x < width && y < height);
 
-                buffer[y * width + x] = color;
+                buffer[y * pitch + x] = color;
             }
 
             void set_color (unsigned offset, Color & color)
             {
-                assert(offset < buffer.size ());
+                assert(offset < storage_size);
 
                 buffer[offset] = color;
             }
@@ -116,6 +270,103 @@
                 return colors ();
             }
 
+        private:
+
+            /** El pitch es el menor múltiplo de la granularidad que no es inferior al ancho, siendo
+              * la granularidad el menor número de colores que ocupa un múltiplo de row_alignment bytes
+              * (en los formatos de 3, 6 o 12 bytes no basta con redondear los bytes de la fila).
+              */
+            static unsigned padded_pitch (unsigned width, unsigned row_alignment)
+            {
+                assert(row_alignment > 0 && (row_alignment & (row_alignment - 1)) == 0);
+
+                unsigned granularity = 1;
+
+                while (granularity * sizeof(Color_Format) % row_alignment != 0) granularity++;
+
+                return (width + granularity - 1) / granularity * granularity;
+            }
+
+            static Buffer allocate (size_t count, const Allocation_Policy & allocation)
+            {
+                size_t alignment = std::max< size_t > (base_alignment, allocation.row_alignment);
+
+                Color_Format * colors = static_cast< Color_Format * >
+                (
+                    ::operator new (std::max< size_t > (count, 1) * sizeof(Color_Format), std::align_val_t(alignment))
+                );
+
+                if (allocation.initialize)
+                    std::uninitialized_value_construct_n   (colors, count);
+                else
+                    std::uninitialized_default_construct_n (colors, count);
+
+                return Buffer(colors, Aligned_Delete{ count, alignment });
+            }
+
+            static unsigned lowest_bit (uint32_t mask)
+            {
+                #if defined(_MSC_VER)
+                    unsigned long index;
+                    _BitScanForward (&index, mask);
+                    return unsigned(index);
+                #else
+                    return unsigned(__builtin_ctz (mask));
+                #endif
+            }
+
+            static void fill (Color_Format * target, unsigned count, const Color & color)
+            {
+                if constexpr (sizeof(Color_Format) == 1)
+                {
+                    std::memset (target, reinterpret_cast< const uint8_t & >(color), count);
+                }
+                else
+                if constexpr (pattern_bytes % sizeof(Color_Format) == 0)
+                {
+                    // Los spans cortos no compensan la preparación del patrón:
+
+                    if (count < 2 * pattern_colors)
+                    {
+                        std::fill_n (target, count, color);
+                        return;
+                    }
+
+                    Color_Format pattern[pattern_colors];
+
+                    std::fill_n (pattern, pattern_colors, color);
+
+                    uint8_t * bytes  = reinterpret_cast< uint8_t * >(target);
+                    unsigned blocks  = count / pattern_colors;
+
+                    #ifdef ARGB_SSE2_AVAILABLE
+
+                        const __m128i p0 = _mm_loadu_si128 (reinterpret_cast< const __m128i * >(pattern) + 0);
+                        const __m128i p1 = _mm_loadu_si128 (reinterpret_cast< const __m128i * >(pattern) + 1);
+                        const __m128i p2 = _mm_loadu_si128 (reinterpret_cast< const __m128i * >(pattern) + 2);
+
+                        for (unsigned block = 0; block < blocks; ++block, bytes += pattern_bytes)
+                        {
+                            _mm_storeu_si128 (reinterpret_cast< __m128i * >(bytes) + 0, p0);
+                            _mm_storeu_si128 (reinterpret_cast< __m128i * >(bytes) + 1, p1);
+                            _mm_storeu_si128 (reinterpret_cast< __m128i * >(bytes) + 2, p2);
+                        }
+
+                    #else
+
+                        for (unsigned block = 0; block < blocks; ++block, bytes += pattern_bytes)
+                        {
+                            std::memcpy (bytes, pattern, pattern_bytes);
+                        }
+
+                    #endif
+
+                    std::fill_n (target + blocks * pattern_colors, count - blocks * pattern_colors, color);
+                }
+                else
+                    std::fill_n (target, count, color);
+            }
+
         };
 
     }
@@ -42,7 +42,7 @@
                 argb::copy
                 (
                     reinterpret_cast< Rgb24 * >(loaded_pixels),
-                    reinterpret_cast< COLOR_FORMAT * >(bitmap->pixels ()),
+                    reinterpret_cast< COLOR_FORMAT * >(bitmap->colors ()),
                     bitmap->get_size ()
                 );
 
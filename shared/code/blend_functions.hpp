@@ -7,7 +7,11 @@
 #ifndef ARGB_BLEND_FUNCTIONS_HEADER
 #define ARGB_BLEND_FUNCTIONS_HEADER
 
+    #include <algorithm>
+    #include <cstdint>
+    #include <type_traits>
     #include "Color.hpp"
+    #include "cpu_dispatch.hpp"
 
     namespace argb
     {
@@ -35,8 +39,48 @@
 
         // QUIZS LA VERSIN FAST DEBERA SER LA VERSIN POR DEFECTO?
 
+        // Versin genrica: media de cada componente. En los formatos empaquetados los componentes
+        // se separan con sus mscaras:
+
+        template< class COLOR, unsigned COMPONENT = 0 >
+        inline typename COLOR::Composite_Type blend_half_packed (const COLOR & destination, const COLOR & source)
+        {
+            using Composite = typename COLOR::Composite_Type;
+            using Traits    = typename COLOR::template Component_Traits< COMPONENT >;
+
+            unsigned sum = unsigned((destination.value >> Traits::shift) & Traits::mask)
+                         + unsigned((source.value      >> Traits::shift) & Traits::mask);
+
+            Composite result = Composite(Composite(sum >> 1) << Traits::shift);
+
+            if constexpr (COMPONENT + 1 < COLOR::component_count)
+            {
+                result = Composite(result | blend_half_packed< COLOR, COMPONENT + 1 > (destination, source));
+            }
+
+            return result;
+        }
+
         template< class COLOR >
-        void blend_half (COLOR & destination, const COLOR & source);
+        inline void blend_half (COLOR & destination, const COLOR & source)
+        {
+            using Component = typename COLOR::Component_Type;
+
+            if constexpr (std::is_void< Component >::value)
+            {
+                destination.value = blend_half_packed (destination, source);
+            }
+            else
+            {
+                for (unsigned i = 0; i < COLOR::component_count; ++i)
+                {
+                    if constexpr (std::is_floating_point< Component >::value)
+                        destination.components[i] = (destination.components[i] + source.components[i]) * Component(0.5);
+                    else
+                        destination.components[i] = Component((uint64_t(destination.components[i]) + source.components[i]) >> 1);
+                }
+            }
+        }
 
         template< class COLOR >
         inline void blend_half_fast (COLOR & destination, const COLOR & source)
@@ -84,6 +128,290 @@
             destination.blue  () = (destination.blue  () + source.blue  ()) >> 1;
         }
 
+        // -------------------------------------------------------------------------------------- //
+        // BLEND ALPHA
+
+        // Mezclas con el alpha del color de origen para los formatos de 4 componentes de 8 bits
+        // (Rgba8888, Argb8888, etc.):
+        //
+        //   SOURCE_OVER:   color = s * a + d * (1 - a)            alpha = a + da * (1 - a)
+        //   PREMULTIPLIED: color = s     + d * (1 - a)            alpha = a + da * (1 - a)
+        //   ADDITIVE:      color = d + s * a (saturado)           alpha = da + a (saturado)
+        //   MULTIPLY:      color = d * (s * a + (1 - a))          alpha = da
+        //
+        // Los productos se dividen entre 255 redondeando, con la misma aritmtica entera que los
+        // kernels SIMD de blend_alpha_row(), de modo que el resultado no depende del nivel de CPU.
+
+        enum class Alpha_Blend
+        {
+            SOURCE_OVER,
+            PREMULTIPLIED,
+            ADDITIVE,
+            MULTIPLY
+        };
+
+        namespace internal
+        {
+
+            template< class COLOR >
+            constexpr bool is_alpha8888 ()
+            {
+                return sizeof(COLOR) == 4 && COLOR::component_count == 4 && std::is_same< typename COLOR::Component_Type, uint8_t >::value;
+            }
+
+            // round (value / 255) para value <= 255 * 255:
+
+            inline unsigned divide_by_255 (unsigned value)
+            {
+                value += 128;
+                return (value + (value >> 8)) >> 8;
+            }
+
+        }
+
+        /** Todas las mezclas salvo PREMULTIPLIED aplican al canal alpha la misma frmula que al
+          * resto tomando 255 como componente alpha del origen, lo que da las frmulas de la tabla.
+          */
+        template< Alpha_Blend OPERATION, class COLOR >
+        inline void blend_alpha (COLOR & destination, const COLOR & source)
+        {
+            static_assert(internal::is_alpha8888< COLOR > (), "Alpha blending requires a 4 x 8 bit color format.");
+
+            const unsigned alpha   = source.components[COLOR::ALPHA];
+            const unsigned inverse = 255 - alpha;
+
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                const unsigned s = OPERATION != Alpha_Blend::PREMULTIPLIED && i == COLOR::ALPHA ? 255 : source.components[i];
+                const unsigned d = destination.components[i];
+
+                unsigned result;
+
+                switch (OPERATION)
+                {
+                    case Alpha_Blend::SOURCE_OVER:   result = internal::divide_by_255 (s * alpha + d * inverse); break;
+                    case Alpha_Blend::PREMULTIPLIED: result = s + internal::divide_by_255 (d * inverse);         break;
+                    case Alpha_Blend::ADDITIVE:      result = d + internal::divide_by_255 (s * alpha);           break;
+                    default:                         result = internal::divide_by_255 (d * (internal::divide_by_255 (s * alpha) + inverse));
+                }
+
+                destination.components[i] = uint8_t(std::min (result, 255u));
+            }
+        }
+
+        template< class COLOR >
+        inline void blend_source_over (COLOR & destination, const COLOR & source)
+        {
+            blend_alpha< Alpha_Blend::SOURCE_OVER > (destination, source);
+        }
+
+        template< class COLOR >
+        inline void blend_premultiplied (COLOR & destination, const COLOR & source)
+        {
+            blend_alpha< Alpha_Blend::PREMULTIPLIED > (destination, source);
+        }
+
+        template< class COLOR >
+        inline void blend_additive (COLOR & destination, const COLOR & source)
+        {
+            blend_alpha< Alpha_Blend::ADDITIVE > (destination, source);
+        }
+
+        template< class COLOR >
+        inline void blend_multiply (COLOR & destination, const COLOR & source)
+        {
+            blend_alpha< Alpha_Blend::MULTIPLY > (destination, source);
+        }
+
+        namespace internal
+        {
+
+            #ifdef ARGB_SSE2_AVAILABLE
+
+                inline __m128i divide_by_255_sse2 (__m128i value)
+                {
+                    value = _mm_add_epi16 (value, _mm_set1_epi16 (128));
+                    return _mm_srli_epi16 (_mm_add_epi16 (value, _mm_srli_epi16 (value, 8)), 8);
+                }
+
+                // Mezcla dos pxeles por vector, con un componente en cada entero de 16 bits.
+                // alpha_mask tiene 255 en los componentes alpha:
+
+                template< Alpha_Blend OPERATION, unsigned ALPHA >
+                inline __m128i blend_alpha_sse2 (__m128i destination, __m128i source, __m128i alpha_mask)
+                {
+                    const __m128i alpha   = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (source, ALPHA * 0x55), ALPHA * 0x55);
+                    const __m128i inverse = _mm_sub_epi16 (_mm_set1_epi16 (255), alpha);
+
+                    if (OPERATION != Alpha_Blend::PREMULTIPLIED) source = _mm_or_si128 (source, alpha_mask);
+
+                    switch (OPERATION)
+                    {
+                        case Alpha_Blend::SOURCE_OVER:   return divide_by_255_sse2 (_mm_add_epi16 (_mm_mullo_epi16 (source, alpha), _mm_mullo_epi16 (destination, inverse)));
+                        case Alpha_Blend::PREMULTIPLIED: return _mm_add_epi16 (source, divide_by_255_sse2 (_mm_mullo_epi16 (destination, inverse)));
+                        case Alpha_Blend::ADDITIVE:      return _mm_add_epi16 (destination, divide_by_255_sse2 (_mm_mullo_epi16 (source, alpha)));
+                        default:                         return divide_by_255_sse2 (_mm_mullo_epi16 (destination, _mm_add_epi16 (divide_by_255_sse2 (_mm_mullo_epi16 (source, alpha)), inverse)));
+                    }
+                }
+
+            #endif
+
+            #ifdef ARGB_AVX2_DISPATCH
+
+                ARGB_AVX2_TARGET inline __m256i divide_by_255_avx2 (__m256i value)
+                {
+                    value = _mm256_add_epi16 (value, _mm256_set1_epi16 (128));
+                    return _mm256_srli_epi16 (_mm256_add_epi16 (value, _mm256_srli_epi16 (value, 8)), 8);
+                }
+
+                template< Alpha_Blend OPERATION, unsigned ALPHA >
+                ARGB_AVX2_TARGET inline __m256i blend_alpha_avx2 (__m256i destination, __m256i source, __m256i alpha_mask)
+                {
+                    const __m256i alpha   = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (source, ALPHA * 0x55), ALPHA * 0x55);
+                    const __m256i inverse = _mm256_sub_epi16 (_mm256_set1_epi16 (255), alpha);
+
+                    if (OPERATION != Alpha_Blend::PREMULTIPLIED) source = _mm256_or_si256 (source, alpha_mask);
+
+                    switch (OPERATION)
+                    {
+                        case Alpha_Blend::SOURCE_OVER:   return divide_by_255_avx2 (_mm256_add_epi16 (_mm256_mullo_epi16 (source, alpha), _mm256_mullo_epi16 (destination, inverse)));
+                        case Alpha_Blend::PREMULTIPLIED: return _mm256_add_epi16 (source, divide_by_255_avx2 (_mm256_mullo_epi16 (destination, inverse)));
+                        case Alpha_Blend::ADDITIVE:      return _mm256_add_epi16 (destination, divide_by_255_avx2 (_mm256_mullo_epi16 (source, alpha)));
+                        default:                         return divide_by_255_avx2 (_mm256_mullo_epi16 (destination, _mm256_add_epi16 (divide_by_255_avx2 (_mm256_mullo_epi16 (source, alpha)), inverse)));
+                    }
+                }
+
+                // Parte AVX2 de blend_alpha_row(). Devuelve cuntos pxeles ha procesado:
+
+                template< Alpha_Blend OPERATION, class COLOR >
+                ARGB_AVX2_TARGET inline unsigned blend_alpha_row_avx2 (COLOR * destination, const COLOR * source, unsigned count)
+                {
+                    const __m256i zero       = _mm256_setzero_si256 ();
+                    const __m256i alpha_mask = _mm256_set1_epi64x (int64_t(uint64_t(0xFF) << (16 * COLOR::ALPHA)));
+
+                    unsigned index = 0;
+
+                    for ( ; index + 8 <= count; index += 8)
+                    {
+                        const __m256i s = _mm256_loadu_si256 ((const __m256i *)(source      + index));
+                        const __m256i d = _mm256_loadu_si256 ((const __m256i *)(destination + index));
+
+                        const __m256i low  = blend_alpha_avx2< OPERATION, COLOR::ALPHA > (_mm256_unpacklo_epi8 (d, zero), _mm256_unpacklo_epi8 (s, zero), alpha_mask);
+                        const __m256i high = blend_alpha_avx2< OPERATION, COLOR::ALPHA > (_mm256_unpackhi_epi8 (d, zero), _mm256_unpackhi_epi8 (s, zero), alpha_mask);
+
+                        _mm256_storeu_si256 ((__m256i *)(destination + index), _mm256_packus_epi16 (low, high));
+                    }
+
+                    return index;
+                }
+
+            #endif
+
+        }
+
+        /** Mezcla count pxeles consecutivos de source sobre destination. Se procesan 8 pxeles a
+          * la vez con AVX2 o 4 con SSE2, segn argb::get_cpu_tier (), y el resto uno a uno. Los
+          * desempaquetados y empaquetados de 8 a 16 bits actan dentro de cada mitad de 128 bits
+          * del registro, as que el orden de los pxeles se conserva.
+          */
+        template< Alpha_Blend OPERATION, class COLOR >
+        inline void blend_alpha_row (COLOR * destination, const COLOR * source, unsigned count)
+        {
+            static_assert(internal::is_alpha8888< COLOR > (), "Alpha blending requires a 4 x 8 bit color format.");
+
+            const Cpu_Tier tier  = get_cpu_tier ();
+            unsigned       index = 0;
+
+            #ifdef ARGB_AVX2_DISPATCH
+
+                if (tier >= Cpu_Tier::AVX2) index = internal::blend_alpha_row_avx2< OPERATION > (destination, source, count);
+
+            #endif
+
+            #ifdef ARGB_SSE2_AVAILABLE
+
+                if (tier >= Cpu_Tier::SSE2)
+                {
+                    const __m128i zero       = _mm_setzero_si128 ();
+                    const __m128i alpha_mask = _mm_set1_epi64x (int64_t(uint64_t(0xFF) << (16 * COLOR::ALPHA)));
+
+                    for ( ; index + 4 <= count; index += 4)
+                    {
+                        const __m128i s = _mm_loadu_si128 ((const __m128i *)(source      + index));
+                        const __m128i d = _mm_loadu_si128 ((const __m128i *)(destination + index));
+
+                        const __m128i low  = internal::blend_alpha_sse2< OPERATION, COLOR::ALPHA > (_mm_unpacklo_epi8 (d, zero), _mm_unpacklo_epi8 (s, zero), alpha_mask);
+                        const __m128i high = internal::blend_alpha_sse2< OPERATION, COLOR::ALPHA > (_mm_unpackhi_epi8 (d, zero), _mm_unpackhi_epi8 (s, zero), alpha_mask);
+
+                        _mm_storeu_si128 ((__m128i *)(destination + index), _mm_packus_epi16 (low, high));
+                    }
+                }
+
+            #endif
+
+            for ( ; index < count; ++index)
+            {
+                blend_alpha< OPERATION > (destination[index], source[index]);
+            }
+        }
+
+        // -------------------------------------------------------------------------------------- //
+        // BLEND POR FILAS
+
+        /** Aplica BLEND_FUNCTION a una fila de count pxeles. Por defecto llama a la funcin con
+          * cada pxel (integrada, al ser un parmetro de plantilla). Las mezclas que tienen una
+          * versin SIMD se especializan ms abajo para sus formatos, de modo que el Blitter las
+          * usa con solo pasar la funcin de siempre como BLEND_FUNCTION.
+          */
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        struct Blend_Row
+        {
+            static void apply (COLOR * destination, const COLOR * source, unsigned count)
+            {
+                // La copia de los colores uno a uno no se vectoriza (el compilador no puede
+                // descartar que las filas se solapen), as que blend_replace copia la fila entera.
+                // No se usa if constexpr porque GCC no admite comparar direcciones de funciones en
+                // una expresin constante, pero la condicin se resuelve igualmente al compilar:
+
+                if (BLEND_FUNCTION == &blend_replace< COLOR >)
+                {
+                    std::copy_n (source, count, destination);
+                }
+                else
+                {
+                    for (auto end = destination + count; destination < end; )
+                    {
+                        BLEND_FUNCTION (*destination++, *source++);
+                    }
+                }
+            }
+        };
+
+        template< class COLOR, Alpha_Blend OPERATION >
+        struct Alpha_Blend_Row
+        {
+            static void apply (COLOR * destination, const COLOR * source, unsigned count)
+            {
+                blend_alpha_row< OPERATION > (destination, source, count);
+            }
+        };
+
+        template< > struct Blend_Row< Rgba8888, blend_source_over  < Rgba8888 > > : Alpha_Blend_Row< Rgba8888, Alpha_Blend::SOURCE_OVER   > { };
+        template< > struct Blend_Row< Rgba8888, blend_premultiplied< Rgba8888 > > : Alpha_Blend_Row< Rgba8888, Alpha_Blend::PREMULTIPLIED > { };
+        template< > struct Blend_Row< Rgba8888, blend_additive     < Rgba8888 > > : Alpha_Blend_Row< Rgba8888, Alpha_Blend::ADDITIVE      > { };
+        template< > struct Blend_Row< Rgba8888, blend_multiply     < Rgba8888 > > : Alpha_Blend_Row< Rgba8888, Alpha_Blend::MULTIPLY      > { };
+
+        template< > struct Blend_Row< Argb8888, blend_source_over  < Argb8888 > > : Alpha_Blend_Row< Argb8888, Alpha_Blend::SOURCE_OVER   > { };
+        template< > struct Blend_Row< Argb8888, blend_premultiplied< Argb8888 > > : Alpha_Blend_Row< Argb8888, Alpha_Blend::PREMULTIPLIED > { };
+        template< > struct Blend_Row< Argb8888, blend_additive     < Argb8888 > > : Alpha_Blend_Row< Argb8888, Alpha_Blend::ADDITIVE      > { };
+        template< > struct Blend_Row< Argb8888, blend_multiply     < Argb8888 > > : Alpha_Blend_Row< Argb8888, Alpha_Blend::MULTIPLY      > { };
+
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blend_row (COLOR * destination, const COLOR * source, unsigned count)
+        {
+            Blend_Row< COLOR, BLEND_FUNCTION >::apply (destination, source, count);
+        }
+
     }
 
 #endif
@@ -7,6 +7,7 @@
 #ifndef ARGB_BLITTER_TRANSFORMS_HEADER
 #define ARGB_BLITTER_TRANSFORMS_HEADER
 
+    #include <algorithm>
     #include "Color_Buffer.hpp"
     #include "blend_functions.hpp"
 
@@ -53,16 +54,252 @@
 
             while (_.source.height--)
             {
-                for (auto end = _.target.pointer + _.source.width; _.target.pointer < end; )
+                blend_row< COLOR, BLEND_FUNCTION > (_.target.pointer, _.source.pointer, _.source.width);
+
+                _.source.pointer += _.source.width + _.source.delta;
+                _.target.pointer += _.source.width + delta;
+            }
+        }
+
+        // -------------------------------------------------------------------------------------- //
+
+        // Todas las transformaciones escriben en el destino filas completas (o tramos de fila) con
+        // blend_row(), as que se combinan con cualquier funcin de mezcla y aprovechan sus
+        // versiones SIMD. Las que invierten el orden de los pxeles preparan antes cada tramo en
+        // un buffer pequeo que no sale de la cach L1.
+
+        namespace blitter_transform
+        {
+
+            // Pxeles por tramo al invertir filas y lado de los bloques al rotar 90 o 270 grados.
+            // Un bloque ocupa como mucho 4 KB:
+
+            constexpr unsigned span_size = 256;
+
+            template< class COLOR >
+            constexpr unsigned block_size ()
+            {
+                return sizeof(COLOR) <= 4 ? 32 : 16;
+            }
+
+            // Mezcla en target los count pxeles que terminan en source_end, de derecha a izquierda:
+
+            template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+            inline void blend_row_reversed (COLOR * target, const COLOR * source_end, unsigned count)
+            {
+                COLOR span[span_size];
+
+                while (count)
+                {
+                    unsigned length = std::min (count, span_size);
+
+                    std::reverse_copy (source_end - length, source_end, span);
+
+                    blend_row< COLOR, BLEND_FUNCTION > (target, span, length);
+
+                    target     += length;
+                    source_end -= length;
+                    count      -= length;
+                }
+            }
+
+            template< class COLOR, bool CLOCKWISE >
+            inline void transpose_block
+            (
+                COLOR         (* tile)[block_size< COLOR > ()],
+                const COLOR    * source,
+                unsigned         source_pitch,
+                unsigned         rows,
+                unsigned         columns
+            )
+            {
+                for (unsigned y = 0; y < rows; ++y, source += source_pitch)
+                {
+                    for (unsigned x = 0; x < columns; ++x)
+                    {
+                        if (CLOCKWISE)
+                            tile[x][rows - 1 - y] = source[x];
+                        else
+                            tile[columns - 1 - x][y] = source[x];
+                    }
+                }
+            }
+
+            #ifdef ARGB_SSE2_AVAILABLE
+
+                // Versin para bloques completos de colores de 32 bits, que traspone submatrices de
+                // 4 x 4 colores en registros:
+
+                template< class COLOR, bool CLOCKWISE >
+                inline void transpose_block_sse2 (COLOR (* tile)[block_size< COLOR > ()], const COLOR * source, unsigned source_pitch)
+                {
+                    constexpr unsigned block = block_size< COLOR > ();
+
+                    for (unsigned y = 0; y < block; y += 4)
+                    {
+                        const COLOR * row = source + size_t(y) * source_pitch;
+
+                        for (unsigned x = 0; x < block; x += 4)
+                        {
+                            __m128i r0 = _mm_loadu_si128 ((const __m128i *)(row + x                   ));
+                            __m128i r1 = _mm_loadu_si128 ((const __m128i *)(row + x +     source_pitch));
+                            __m128i r2 = _mm_loadu_si128 ((const __m128i *)(row + x + 2 * source_pitch));
+                            __m128i r3 = _mm_loadu_si128 ((const __m128i *)(row + x + 3 * source_pitch));
+
+                            const __m128i t0 = _mm_unpacklo_epi32 (r0, r1);
+                            const __m128i t1 = _mm_unpacklo_epi32 (r2, r3);
+                            const __m128i t2 = _mm_unpackhi_epi32 (r0, r1);
+                            const __m128i t3 = _mm_unpackhi_epi32 (r2, r3);
+
+                            // Ahora cj contiene la columna x + j de las cuatro filas:
+
+                            __m128i c[4] =
+                            {
+                                _mm_unpacklo_epi64 (t0, t1),
+                                _mm_unpackhi_epi64 (t0, t1),
+                                _mm_unpacklo_epi64 (t2, t3),
+                                _mm_unpackhi_epi64 (t2, t3),
+                            };
+
+                            for (unsigned j = 0; j < 4; ++j)
+                            {
+                                if (CLOCKWISE)
+                                    _mm_storeu_si128 ((__m128i *)(tile[x + j] + block - 4 - y), _mm_shuffle_epi32 (c[j], 0x1B));
+                                else
+                                    _mm_storeu_si128 ((__m128i *)(tile[block - 1 - x - j] + y), c[j]);
+                            }
+                        }
+                    }
+                }
+
+            #endif
+
+            /** Rota 90 grados en sentido horario (CLOCKWISE = true) o antihorario. Recorrer el
+              * origen por filas obligara a escribir el destino por columnas (y al revs), con un
+              * fallo de cach por pxel en imgenes grandes. Por eso se avanza por bloques
+              * cuadrados: cada bloque se lee por filas y se traspone en un buffer local, cuyas
+              * filas se mezclan despus con las del destino.
+              */
+            template< class COLOR, blend_function< COLOR > BLEND_FUNCTION, bool CLOCKWISE >
+            inline void blit_rotated (Details< COLOR > & _)
+            {
+                constexpr unsigned block = block_size< COLOR > ();
+
+                const unsigned width        = _.source.width;
+                const unsigned height       = _.source.height;
+                const unsigned source_pitch = _.source.width + _.source.delta;
+                const unsigned target_pitch = _.target.pitch.x;
+
+                COLOR tile[block][block];
+
+                for (unsigned y0 = 0; y0 < height; y0 += block)
                 {
-                    BLEND_FUNCTION (*_.target.pointer++, *_.source.pointer++);
+                    const unsigned rows = std::min (block, height - y0);
+
+                    for (unsigned x0 = 0; x0 < width; x0 += block)
+                    {
+                        const unsigned columns = std::min (block, width - x0);
+
+                        // La columna x del bloque pasa a ser una fila del destino. En sentido
+                        // horario la fila y del origen acaba en la columna height - 1 - y y en
+                        // sentido antihorario la columna x acaba en la fila width - 1 - x:
+
+                        const COLOR * source = _.source.pointer + size_t(y0) * source_pitch + x0;
+
+                        #ifdef ARGB_SSE2_AVAILABLE
+
+                            if constexpr (sizeof(COLOR) == 4)
+                            {
+                                if (rows == block && columns == block)
+                                {
+                                    transpose_block_sse2< COLOR, CLOCKWISE > (tile, source, source_pitch);
+                                }
+                                else
+                                    transpose_block< COLOR, CLOCKWISE > (tile, source, source_pitch, rows, columns);
+                            }
+                            else
+
+                        #endif
+
+                        transpose_block< COLOR, CLOCKWISE > (tile, source, source_pitch, rows, columns);
+
+                        const unsigned target_x = CLOCKWISE ? height - y0 - rows : y0;
+                        const unsigned target_y = CLOCKWISE ? x0 : width - x0 - columns;
+
+                        COLOR * target = _.target.pointer + size_t(target_y) * target_pitch + target_x;
+
+                        for (unsigned row = 0; row < columns; ++row, target += target_pitch)
+                        {
+                            blend_row< COLOR, BLEND_FUNCTION > (target, tile[row], rows);
+                        }
+                    }
                 }
+            }
 
-                _.source.pointer += _.source.delta;
-                _.target.pointer += delta;
+        }
+
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blit_flip_horizontal (blitter_transform::Details< COLOR > & _)
+        {
+            const unsigned source_pitch = _.source.width + _.source.delta;
+
+            for (unsigned y = 0; y < _.source.height; ++y)
+            {
+                blitter_transform::blend_row_reversed< COLOR, BLEND_FUNCTION >
+                (
+                    _.target.pointer + size_t(y) * _.target.pitch.x,
+                    _.source.pointer + size_t(y) * source_pitch + _.source.width,
+                    _.source.width
+                );
             }
         }
 
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blit_flip_vertical (blitter_transform::Details< COLOR > & _)
+        {
+            const unsigned source_pitch = _.source.width + _.source.delta;
+
+            for (unsigned y = 0; y < _.source.height; ++y)
+            {
+                blend_row< COLOR, BLEND_FUNCTION >
+                (
+                    _.target.pointer + size_t(_.source.height - 1 - y) * _.target.pitch.x,
+                    _.source.pointer + size_t(y) * source_pitch,
+                    _.source.width
+                );
+            }
+        }
+
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blit_rotate_180 (blitter_transform::Details< COLOR > & _)
+        {
+            const unsigned source_pitch = _.source.width + _.source.delta;
+
+            for (unsigned y = 0; y < _.source.height; ++y)
+            {
+                blitter_transform::blend_row_reversed< COLOR, BLEND_FUNCTION >
+                (
+                    _.target.pointer + size_t(_.source.height - 1 - y) * _.target.pitch.x,
+                    _.source.pointer + size_t(y) * source_pitch + _.source.width,
+                    _.source.width
+                );
+            }
+        }
+
+        // En las rotaciones de 90 y 270 grados el destino mide height x width:
+
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blit_rotate_90 (blitter_transform::Details< COLOR > & _)
+        {
+            blitter_transform::blit_rotated< COLOR, BLEND_FUNCTION, true > (_);
+        }
+
+        template< class COLOR, blend_function< COLOR > BLEND_FUNCTION >
+        inline void blit_rotate_270 (blitter_transform::Details< COLOR > & _)
+        {
+            blitter_transform::blit_rotated< COLOR, BLEND_FUNCTION, false > (_);
+        }
+
     }
 
 #endif
@@ -0,0 +1,189 @@
+// Código bajo licencia Boost Software License, version 1.0
+// Ver www.boost.org/LICENSE_1_0.txt
+
+#ifndef ARGB_CPU_DISPATCH_HEADER
+#define ARGB_CPU_DISPATCH_HEADER
+
+    #include <algorithm>
+    #include <atomic>
+    #include <cstdint>
+
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define ARGB_SSE2_AVAILABLE
+        #include <emmintrin.h>
+    #endif
+
+    // Los kernels AVX2 se compilan aunque el resto del programa no use AVX2, y solo se ejecutan si
+    // la CPU lo admite. MSVC permite usar sus intrínsecas en cualquier función. GCC y Clang solo en
+    // las funciones marcadas con el atributo target, así que los métodos de los vectores AVX2 se
+    // marcan con ARGB_AVX2_TARGET y la función de entrada de cada kernel con ARGB_AVX2_KERNEL, que
+    // además integra (flatten) todo el código al que llama para compilarlo también para AVX2:
+
+    #if defined(ARGB_SSE2_AVAILABLE) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+        #define ARGB_AVX2_DISPATCH
+        #include <immintrin.h>
+    #endif
+
+    #if defined(__GNUC__) || defined(__clang__)
+        #define ARGB_AVX2_TARGET __attribute__((target("avx2")))
+        #define ARGB_AVX2_KERNEL __attribute__((target("avx2"), flatten))
+    #else
+        #define ARGB_AVX2_TARGET
+        #define ARGB_AVX2_KERNEL
+    #endif
+
+    #if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        #include <cpuid.h>
+    #endif
+
+    namespace argb
+    {
+
+        // Niveles de instrucciones SIMD, de menor a mayor. Cada nivel incluye los anteriores:
+
+        enum class Cpu_Tier
+        {
+            SCALAR,
+            SSE2,
+            AVX2,
+            AVX512
+        };
+
+        inline const char * get_cpu_tier_name (Cpu_Tier tier)
+        {
+            switch (tier)
+            {
+                case Cpu_Tier::SSE2:   return "sse2";
+                case Cpu_Tier::AVX2:   return "avx2";
+                case Cpu_Tier::AVX512: return "avx512";
+                default:               return "scalar";
+            }
+        }
+
+        /** Consulta con cpuid el nivel más alto que admiten la CPU y el sistema operativo (que debe
+          * guardar los registros ymm y zmm en los cambios de contexto, según indica xgetbv). Para
+          * AVX-512 se exigen F, VL y BW.
+          */
+        inline Cpu_Tier detect_cpu_tier ()
+        {
+            #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+
+                auto cpuid = [] (uint32_t leaf, uint32_t registers[4])
+                {
+                    int values[4];
+                    __cpuidex (values, int(leaf), 0);
+                    for (int i = 0; i < 4; ++i) registers[i] = uint32_t(values[i]);
+                };
+
+                auto xgetbv = [] () { return uint64_t(_xgetbv (0)); };
+
+            #elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+                auto cpuid = [] (uint32_t leaf, uint32_t registers[4])
+                {
+                    registers[0] = registers[1] = registers[2] = registers[3] = 0;
+                    __get_cpuid_count (leaf, 0, &registers[0], &registers[1], &registers[2], &registers[3]);
+                };
+
+                auto xgetbv = [] ()
+                {
+                    uint32_t low, high;
+                    __asm__ ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+                    return uint64_t(high) << 32 | low;
+                };
+
+            #else
+
+                return Cpu_Tier::SCALAR;
+
+            #endif
+
+            #if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+                uint32_t leaf0[4], leaf1[4], leaf7[4] = { 0, 0, 0, 0 };
+
+                cpuid (0, leaf0);
+                cpuid (1, leaf1);
+
+                if (leaf0[0] >= 7) cpuid (7, leaf7);
+
+                const bool sse2    = (leaf1[3] & (1u << 26)) != 0;
+                const bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+                const bool avx     = (leaf1[2] & (1u << 28)) != 0;
+
+                if (!sse2) return Cpu_Tier::SCALAR;
+
+                if (!osxsave || !avx) return Cpu_Tier::SSE2;
+
+                const uint64_t xcr0 = xgetbv ();
+
+                if ((xcr0 & 0x06) != 0x06 || !(leaf7[1] & (1u << 5))) return Cpu_Tier::SSE2;
+
+                const uint32_t avx512 = (1u << 16) | (1u << 30) | (1u << 31);       // F, BW, VL
+
+                if ((xcr0 & 0xE6) != 0xE6 || (leaf7[1] & avx512) != avx512) return Cpu_Tier::AVX2;
+
+                return Cpu_Tier::AVX512;
+
+            #endif
+        }
+
+        namespace internal
+        {
+
+            inline std::atomic< int > & active_cpu_tier ()
+            {
+                static std::atomic< int > tier{ int(detect_cpu_tier ()) };
+                return tier;
+            }
+
+        }
+
+        // Nivel con el que se eligen los kernels. Se detecta una sola vez, la primera vez que se
+        // consulta:
+
+        inline Cpu_Tier get_cpu_tier ()
+        {
+            return Cpu_Tier(internal::active_cpu_tier ().load (std::memory_order_relaxed));
+        }
+
+        /** Modo de prueba: limita los kernels que se eligen a partir de ahora a tier (o al nivel de
+          * la CPU si es menor, que es el que se devuelve) para comparar los resultados de cada
+          * nivel con los de la versión escalar. Los kernels ya elegidos no cambian.
+          */
+        inline Cpu_Tier force_cpu_tier (Cpu_Tier tier)
+        {
+            tier = Cpu_Tier(std::min (int(tier), int(detect_cpu_tier ())));
+
+            internal::active_cpu_tier ().store (int(tier), std::memory_order_relaxed);
+
+            return tier;
+        }
+
+        inline void reset_cpu_tier ()
+        {
+            internal::active_cpu_tier ().store (int(detect_cpu_tier ()), std::memory_order_relaxed);
+        }
+
+        /** Devuelve la implementación del nivel activo o, si no se ha compilado (nullptr), la del
+          * nivel inmediatamente inferior que exista. La escalar es obligatoria.
+          */
+        template< class FUNCTION >
+        inline FUNCTION select_by_cpu_tier (FUNCTION scalar, FUNCTION sse2, FUNCTION avx2 = nullptr, FUNCTION avx512 = nullptr)
+        {
+            switch (get_cpu_tier ())
+            {
+                case Cpu_Tier::AVX512: if (avx512) return avx512; [[fallthrough]];
+                case Cpu_Tier::AVX2:   if (avx2  ) return avx2;   [[fallthrough]];
+                case Cpu_Tier::SSE2:   if (sse2  ) return sse2;   [[fallthrough]];
+                default:               return scalar;
+            }
+        }
+
+    }
+
+#endif
@@ -0,0 +1,391 @@
+// Este código es de dominio público.
+
+#ifndef CLIPPER_HEADER
+#define CLIPPER_HEADER
+
+    #include <cmath>
+    #include <cstdint>
+    #include <vector>
+    #include "math.hpp"
+    #include "MeshData.h"
+
+    namespace example
+    {
+
+        /** Etapa de recorte en coordenadas homogéneas que se sitúa entre los vértices ya
+          * proyectados (MeshData::transformed_vertices, antes de dividir entre w) y los vértices
+          * de pantalla (MeshData::display_vertices).
+          *
+          * Solo se recortan de verdad los triángulos que cruzan el plano cercano. Para el resto
+          * de planos se usa una banda de guarda amplia: los triángulos que se salen por los lados
+          * del viewport se pasan tal cual al rasterizer, que ya recorta cada span contra el color
+          * buffer. Únicamente los que se salen también de la banda de guarda (algo muy poco
+          * frecuente) se recortan contra ella para que las coordenadas enteras no desborden.
+          */
+        class Clipper
+        {
+        public:
+
+            // Margen en píxeles alrededor del viewport dentro del cual no se recorta. Con él las
+            // coordenadas de pantalla quedan acotadas lo bastante como para que las funciones de
+            // arista del rasterizer (productos de dos diferencias) quepan en 32 bits:
+
+            static constexpr int guard_band = 8192;
+
+            // Cada vértice creado al recortar es la interpolación lineal entre otros dos (que a su
+            // vez pueden ser originales o creados antes). Con esta información se pueden ampliar
+            // los arrays de atributos paralelos (colores, normales, etc.) en el mismo orden:
+
+            struct Clipped_Vertex
+            {
+                int   from;
+                int   to;
+                float t;
+            };
+
+        private:
+
+            enum Outcode : unsigned
+            {
+                NEAR         = 1 << 0,
+                FAR          = 1 << 1,
+                LEFT         = 1 << 2,
+                RIGHT        = 1 << 3,
+                BOTTOM       = 1 << 4,
+                TOP          = 1 << 5,
+                GUARD_LEFT   = 1 << 6,
+                GUARD_RIGHT  = 1 << 7,
+                GUARD_BOTTOM = 1 << 8,
+                GUARD_TOP    = 1 << 9,
+
+                FRUSTUM      = NEAR | FAR | LEFT | RIGHT | BOTTOM | TOP,
+                MUST_CLIP    = NEAR | GUARD_LEFT | GUARD_RIGHT | GUARD_BOTTOM | GUARD_TOP,
+            };
+
+            // Vértice de trabajo durante el recorte de un polígono:
+
+            struct Clip_Vertex
+            {
+                Point4f position;
+                int     index;
+            };
+
+        private:
+
+            float half_width;
+            float half_height;
+            float guard_x;                          ///< Límite de la banda de guarda en x (en unidades de w).
+            float guard_y;                          ///< Límite de la banda de guarda en y (en unidades de w).
+
+            std::vector< unsigned       > outcodes;
+
+            // Los vértices originales se leen directamente del array que recibe clip(). En
+            // positions solo se guardan los creados al recortar, que tienen los índices a partir
+            // de original_count:
+
+            const Vertex_Buffer         * original_positions = nullptr;
+            size_t                        original_count     = 0;
+            std::vector< Point4f        > positions;
+            std::vector< Clipped_Vertex > clipped_vertices;
+            std::vector< uint32_t       > source_triangles;
+            std::vector< Clip_Vertex    > polygon;
+            std::vector< Clip_Vertex    > polygon_out;
+
+        public:
+
+            Clipper(unsigned viewport_width, unsigned viewport_height)
+            {
+                set_viewport (viewport_width, viewport_height);
+            }
+
+            void set_viewport (unsigned viewport_width, unsigned viewport_height)
+            {
+                half_width  = float(viewport_width ) * 0.5f;
+                half_height = float(viewport_height) * 0.5f;
+                guard_x     = 1.f + float(guard_band) / half_width;
+                guard_y     = 1.f + float(guard_band) / half_height;
+            }
+
+            /** Vértices creados en la última llamada a clip(), en el orden en el que se añadieron
+              * a display_vertices a continuación de los originales.
+              */
+            const std::vector< Clipped_Vertex > & get_clipped_vertices () const
+            {
+                return clipped_vertices;
+            }
+
+            /** Posición en el index buffer de la última llamada a clip() del triángulo del que sale
+              * cada triángulo de visible_indices (varios si se ha recortado).
+              */
+            const std::vector< uint32_t > & get_source_triangles () const
+            {
+                return source_triangles;
+            }
+
+            /** Amplía un array de atributos paralelo a los vértices originales (count valores por
+              * vértice) con los de los vértices creados en la última llamada a clip().
+              */
+            void interpolate_attributes (std::vector< float > & values, unsigned count) const
+            {
+                values.reserve (values.size () + clipped_vertices.size () * count);
+
+                for (const Clipped_Vertex & vertex : clipped_vertices)
+                {
+                    const size_t from = size_t(vertex.from) * count;
+                    const size_t to   = size_t(vertex.to  ) * count;
+
+                    for (unsigned i = 0; i < count; ++i)
+                    {
+                        values.push_back (values[from + i] + (values[to + i] - values[from + i]) * vertex.t);
+                    }
+                }
+            }
+
+            // Número de vértices de la última llamada a clip(), contando los creados:
+
+            size_t get_vertex_count () const
+            {
+                return original_count + positions.size ();
+            }
+
+            // Coordenadas de clip del vértice index (original o creado) de la última llamada a clip():
+
+            const Point4f & get_position (size_t index) const
+            {
+                return index < original_count ? (*original_positions)[index] : positions[index - original_count];
+            }
+
+            /** Escribe el 1 / w de todos los vértices de la última llamada a clip() (los originales
+              * y los creados), que es lo que necesita el rasterizer para interpolar los atributos
+              * con corrección de perspectiva. Los vértices detrás de la cámara reciben 0, pero no
+              * los usa ningún triángulo visible. Los vértices que se pasaron a clip() deben seguir
+              * existiendo.
+              */
+            void get_inverse_w (std::vector< float > & inverse_w) const
+            {
+                inverse_w.resize (get_vertex_count ());
+
+                for (size_t index = 0; index < inverse_w.size (); ++index)
+                {
+                    const Point4f & position = get_position (index);
+
+                    inverse_w[index] = position.w > 0.f ? 1.f / position.w : 0.f;
+                }
+            }
+
+        public:
+
+            /** Proyecta mesh.transformed_vertices en mesh.display_vertices y deja en
+              * visible_indices los triángulos de mesh.original_indices que hay que dibujar.
+              * Si los vértices de pantalla ya se han calculado (por ejemplo con Vertex_Transformer)
+              * se puede pasar project_vertices = false para que solo se añadan los nuevos.
+              */
+            void clip (MeshData & mesh, Index_Buffer & visible_indices, bool project_vertices = true)
+            {
+                clip (mesh.transformed_vertices, mesh.original_indices, mesh.display_vertices, visible_indices, project_vertices);
+            }
+
+            void clip
+            (
+                const Vertex_Buffer      & clip_space_vertices,
+                const Index_Buffer       & indices,
+                std::vector< Point4i >   & display_vertices,
+                Index_Buffer             & visible_indices,
+                bool                       project_vertices = true
+            );
+
+        private:
+
+            unsigned compute_outcode (const Point4f & v) const
+            {
+                unsigned code = 0;
+
+                if (v.z < -v.w) code |= NEAR;
+                if (v.z >  v.w) code |= FAR;
+                if (v.x < -v.w) code |= LEFT;
+                if (v.x >  v.w) code |= RIGHT;
+                if (v.y < -v.w) code |= BOTTOM;
+                if (v.y >  v.w) code |= TOP;
+
+                if (v.x < -guard_x * v.w) code |= GUARD_LEFT;
+                if (v.x >  guard_x * v.w) code |= GUARD_RIGHT;
+                if (v.y < -guard_y * v.w) code |= GUARD_BOTTOM;
+                if (v.y >  guard_y * v.w) code |= GUARD_TOP;
+
+                return code;
+            }
+
+            // Distancia con signo de un vértice a uno de los planos que se recortan (positiva
+            // en el lado que se conserva):
+
+            float plane_distance (unsigned plane, const Point4f & v) const
+            {
+                switch (plane)
+                {
+                    case NEAR:         return v.z + v.w;
+                    case GUARD_LEFT:   return v.x + guard_x * v.w;
+                    case GUARD_RIGHT:  return guard_x * v.w - v.x;
+                    case GUARD_BOTTOM: return v.y + guard_y * v.w;
+                    default:           return guard_y * v.w - v.y;
+                }
+            }
+
+            Point4i project (const Point4f & v) const
+            {
+                float inverse_w = 1.f / v.w;
+
+                return Point4i
+                (
+                    to_int (v.x * inverse_w * half_width  + half_width ),
+                    to_int (v.y * inverse_w * half_height + half_height),
+                    to_int (v.z * inverse_w * depth_scale),
+                    1
+                );
+            }
+
+            // Redondea una coordenada de pantalla acotándola a ±2^30, como Vertex_Transformer, para
+            // que la conversión no desborde con los vértices más allá del plano lejano o de las
+            // esquinas de la banda de guarda (un NaN acaba en el límite inferior):
+
+            static int to_int (float value)
+            {
+                constexpr float limit = 1073741824.f;
+
+                if (value >= -limit && value <= limit) return int(std::nearbyint (value));
+
+                return value > 0.f ? int(limit) : -int(limit);
+            }
+
+            void clip_polygon (unsigned planes, std::vector< Point4i > & display_vertices);
+
+        };
+
+        inline void Clipper::clip
+        (
+            const Vertex_Buffer      & clip_space_vertices,
+            const Index_Buffer       & indices,
+            std::vector< Point4i >   & display_vertices,
+            Index_Buffer             & visible_indices,
+            bool                       project_vertices
+        )
+        {
+            const size_t vertex_count = clip_space_vertices.size ();
+
+            clipped_vertices.clear ();
+            source_triangles.clear ();
+            visible_indices .clear ();
+            visible_indices .reserve (indices.size ());
+            source_triangles.reserve (indices.size () / 3);
+
+            // Se clasifican y se proyectan todos los vértices en una sola pasada. Los que quedan
+            // detrás del plano cercano o fuera de la banda de guarda reciben una proyección
+            // cualquiera porque ningún triángulo que los use llega al rasterizer sin recortar:
+
+            outcodes        .resize (vertex_count);
+            display_vertices.resize (vertex_count);
+
+            for (size_t index = 0; index < vertex_count; ++index)
+            {
+                const Point4f & v = clip_space_vertices[index];
+
+                outcodes[index] = compute_outcode (v);
+
+                if (project_vertices)
+                {
+                    display_vertices[index] = outcodes[index] & MUST_CLIP ? Point4i(0, 0, 0, 1) : project (v);
+                }
+            }
+
+            original_positions = &clip_space_vertices;
+            original_count     = vertex_count;
+
+            positions.clear ();
+
+            for (size_t offset = 0, end = indices.size () / 3 * 3; offset < end; offset += 3)
+            {
+                const int i0 = indices[offset + 0];
+                const int i1 = indices[offset + 1];
+                const int i2 = indices[offset + 2];
+
+                const unsigned c0 = outcodes[i0];
+                const unsigned c1 = outcodes[i1];
+                const unsigned c2 = outcodes[i2];
+
+                // Todos los vértices fuera del mismo plano del frustum:
+
+                if (c0 & c1 & c2 & FRUSTUM) continue;
+
+                // Dentro de la banda de guarda y delante del plano cercano (el caso habitual):
+
+                const unsigned planes = (c0 | c1 | c2) & MUST_CLIP;
+
+                if (planes == 0)
+                {
+                    visible_indices .insert (visible_indices.end (), { i0, i1, i2 });
+                    source_triangles.push_back (uint32_t(offset / 3));
+                    continue;
+                }
+
+                polygon.clear ();
+                polygon.push_back ({ clip_space_vertices[i0], i0 });
+                polygon.push_back ({ clip_space_vertices[i1], i1 });
+                polygon.push_back ({ clip_space_vertices[i2], i2 });
+
+                clip_polygon (planes, display_vertices);
+
+                // El polígono resultante se triangula en abanico:
+
+                for (size_t index = 1; index + 1 < polygon.size (); ++index)
+                {
+                    visible_indices .insert (visible_indices.end (), { polygon[0].index, polygon[index].index, polygon[index + 1].index });
+                    source_triangles.push_back (uint32_t(offset / 3));
+                }
+            }
+        }
+
+        // Sutherland-Hodgman contra cada plano de la máscara. Los vértices nuevos se registran en
+        // clipped_vertices aunque luego algún otro plano los descarte, para que sus índices
+        // coincidan siempre con la posición que ocupan a continuación de los originales:
+
+        inline void Clipper::clip_polygon (unsigned planes, std::vector< Point4i > & display_vertices)
+        {
+            for (unsigned plane = 1; plane <= GUARD_TOP && polygon.size () >= 3; plane <<= 1)
+            {
+                if ((planes & plane) == 0) continue;
+
+                polygon_out.clear ();
+
+                for (size_t index = 0, count = polygon.size (); index < count; ++index)
+                {
+                    const Clip_Vertex & current = polygon[index];
+                    const Clip_Vertex & next    = polygon[(index + 1) % count];
+
+                    const float d0 = plane_distance (plane, current.position);
+                    const float d1 = plane_distance (plane, next   .position);
+
+                    if (d0 >= 0.f) polygon_out.push_back (current);
+
+                    if ((d0 >= 0.f) != (d1 >= 0.f))
+                    {
+                        const float t = d0 / (d0 - d1);
+
+                        Clip_Vertex vertex;
+
+                        vertex.position = current.position + (next.position - current.position) * t;
+                        vertex.index    = int(original_count + positions.size ());
+
+                        positions       .push_back (vertex.position);
+                        display_vertices.push_back (project (vertex.position));
+                        clipped_vertices.push_back ({ current.index, next.index, t });
+
+                        polygon_out.push_back (vertex);
+                    }
+                }
+
+                polygon.swap (polygon_out);
+            }
+        }
+
+    }
+
+#endif
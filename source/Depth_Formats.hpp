@@ -0,0 +1,143 @@
+// Este código es de dominio público.
+
+#ifndef DEPTH_FORMATS_HEADER
+#define DEPTH_FORMATS_HEADER
+
+    #include <algorithm>
+    #include <cstdint>
+    #include <limits>
+    #include "math.hpp"
+
+    namespace example
+    {
+
+        /* Formatos del z-buffer del Rasterizer. Cada uno define:
+         *
+         *   Value          Tipo que se guarda en el z-buffer.
+         *   Interpolant    Tipo con el que se interpolan las profundidades al rellenar.
+         *   reversed       true si los valores mayores están más cerca.
+         *   clamped        true si las profundidades interpoladas se deben limitar a [0, max_depth]
+         *                  antes de guardarlas (el redondeo puede sacarlas un poco del rango).
+         *   far_value ()   Valor con el que se borra el z-buffer.
+         *   from_vertex () Convierte la z entera de un vértice de pantalla en un Interpolant.
+         *   from_clip ()   Solo en los formatos float: convierte la z y la w de clip de un vértice
+         *                  (con w > 0) en un Interpolant. El Rasterizer lo usa en lugar de
+         *                  from_vertex() cuando tiene las coordenadas de clip (draw_indexed() con
+         *                  un MeshData).
+         *   to_value ()    Convierte una profundidad interpolada en el valor que se guarda.
+         *   closer ()      Test de profundidad: si z está más cerca que el valor guardado.
+         *   nearest ()     La más cercana de dos profundidades interpoladas.
+         *   farthest ()    La más lejana de dos profundidades guardadas.
+         *   hidden ()      Si una profundidad mínima queda oculta tras una cota del z-buffer
+         *                  jerárquico, con margen para el error de redondeo de la interpolación.
+         *
+         * Salvo Depth_Int32, los formatos esperan que la z de los vértices siga el convenio de
+         * Clipper (z normalizada multiplicada por depth_scale, de math.hpp) y la llevan a [0, 1].
+         */
+
+        // Entero de 32 bits con la z de los vértices tal cual. Es el formato por defecto:
+
+        struct Depth_Int32
+        {
+            typedef int32_t Value;
+            typedef int32_t Interpolant;
+
+            static constexpr bool reversed = false;
+            static constexpr bool clamped  = false;
+
+            static Value       far_value   ()                                 { return std::numeric_limits< int32_t >::max (); }
+            static Interpolant from_vertex (int z)                            { return z; }
+            static Value       to_value    (Interpolant z)                    { return z; }
+            static bool        closer      (Interpolant z, Value stored)      { return z < stored; }
+            static Interpolant nearest     (Interpolant a, Interpolant b)     { return std::min (a, b); }
+            static Value       farthest    (Value a, Value b)                 { return std::max (a, b); }
+            static bool        hidden      (Interpolant z_min, Value z_max)   { return z_min - 2 >= z_max; }
+        };
+
+        // Enteros sin signo normalizados. Se interpolan como enteros en el rango de destino:
+
+        template< typename VALUE_TYPE, int BITS >
+        struct Depth_Unorm
+        {
+            typedef VALUE_TYPE Value;
+            typedef int32_t    Interpolant;
+
+            static constexpr bool    reversed  = false;
+            static constexpr bool    clamped   = true;
+            static constexpr int32_t max_depth = int32_t((1u << BITS) - 1);
+
+            static Interpolant clamp       (Interpolant z)                    { return std::min (std::max (z, 0), max_depth); }
+            static Value       far_value   ()                                 { return Value(max_depth); }
+            static Value       to_value    (Interpolant z)                    { return Value(clamp (z)); }
+            static bool        closer      (Interpolant z, Value stored)      { return clamp (z) < int32_t(stored); }
+            static Interpolant nearest     (Interpolant a, Interpolant b)     { return std::min (a, b); }
+            static Value       farthest    (Value a, Value b)                 { return std::max (a, b); }
+            static bool        hidden      (Interpolant z_min, Value z_max)   { return z_min - 2 >= int32_t(z_max); }
+
+            static Interpolant from_vertex (int z)
+            {
+                double depth = (double(z) + depth_scale) / (2.0 * depth_scale);
+
+                return Interpolant(std::min (std::max (depth, 0.0), 1.0) * max_depth + 0.5);
+            }
+        };
+
+        typedef Depth_Unorm< uint16_t, 16 > Depth_Unorm16;
+
+        // 24 bits en palabras de 32 (el byte alto queda libre, como en los formatos D24X8):
+
+        typedef Depth_Unorm< uint32_t, 24 > Depth_Unorm24;
+
+        // Float en [0, 1]. Los floats no negativos se ordenan igual que sus bits como enteros,
+        // lo que permite que el test SIMD compare los dos formatos float con enteros. Con las
+        // coordenadas de clip la profundidad sale de z / w sin pasar por la z entera, así que no
+        // queda cuantizada a pasos de 1 / (2 * depth_scale):
+
+        template< bool REVERSED >
+        struct Depth_Float_Format
+        {
+            typedef float Value;
+            typedef float Interpolant;
+
+            static constexpr bool reversed = REVERSED;
+            static constexpr bool clamped  = false;
+
+            static Value       far_value   ()                                 { return REVERSED ? 0.f : 1.f; }
+            static Value       to_value    (Interpolant z)                    { return z; }
+            static bool        closer      (Interpolant z, Value stored)      { return REVERSED ? z > stored : z < stored; }
+            static Interpolant nearest     (Interpolant a, Interpolant b)     { return REVERSED ? std::max (a, b) : std::min (a, b); }
+            static Value       farthest    (Value a, Value b)                 { return REVERSED ? std::min (a, b) : std::max (a, b); }
+
+            static bool hidden (Interpolant z_min, Value z_max)
+            {
+                return REVERSED ? z_min + 1e-6f <= z_max : z_min - 1e-6f >= z_max;
+            }
+
+            static Interpolant from_vertex (int z)
+            {
+                double depth = std::min (std::max ((double(z) + depth_scale) / (2.0 * depth_scale), 0.0), 1.0);
+
+                return Interpolant(REVERSED ? 1.0 - depth : depth);
+            }
+
+            // Se calcula (w ∓ z) / 2w en lugar de 1 ∓ z / w para no perder con la resta los bits que
+            // distinguen las profundidades próximas a 0:
+
+            static Interpolant from_clip (float z, float w)
+            {
+                double depth = (REVERSED ? double(w) - double(z) : double(w) + double(z)) / (2.0 * double(w));
+
+                return Interpolant(std::min (std::max (depth, 0.0), 1.0));
+            }
+        };
+
+        typedef Depth_Float_Format< false > Depth_Float;
+
+        // Z invertida: el plano lejano queda en 0, donde el float tiene más precisión, lo que
+        // compensa que la proyección acumule las profundidades cerca del plano lejano:
+
+        typedef Depth_Float_Format< true  > Depth_Float_Reversed;
+
+    }
+
+#endif
@@ -0,0 +1,200 @@
+// Este código es de dominio público.
+
+#ifndef FRAME_PIPELINE_HEADER
+#define FRAME_PIPELINE_HEADER
+
+    #include <algorithm>
+    #include <cassert>
+    #include <condition_variable>
+    #include <functional>
+    #include <mutex>
+    #include <thread>
+    #include <utility>
+    #include <vector>
+    #include "Thread_Pool.hpp"
+
+    namespace example
+    {
+
+        /** Solapa la preparación de cada frame con el rasterizado de los anteriores. El hilo que
+          * llama a begin_frame() y end_frame() recorre la escena, transforma y dibuja en el
+          * rasterizer, que graba los polígonos en unos Frame_Bins en lugar de rellenarlos. Un hilo
+          * de rasterizado propio rellena después cada frame con el thread pool y llama a present.
+          *
+          * Hay un Frame_Bins por cada frame en vuelo (grabado o grabándose y aún sin presentar),
+          * de modo que con dos se graba el frame N + 1 mientras se rellena el N. begin_frame()
+          * espera si ya hay max_frames_in_flight frames en vuelo, lo que acota la latencia.
+          *
+          * El thread pool queda reservado al hilo de rasterizado: Thread_Pool::run() no admite
+          * llamadas desde dos hilos a la vez, así que la preparación necesita otro pool si quiere
+          * repartir trabajo.
+          */
+        template< class RASTERIZER >
+        class Frame_Pipeline
+        {
+        public:
+
+            typedef RASTERIZER                              Rasterizer;
+            typedef typename Rasterizer::Frame_Bins         Frame_Bins;
+
+            // Se llama desde el hilo de rasterizado en cuanto un frame se ha rellenado, con el
+            // número del frame. El siguiente frame no empieza a rellenarse hasta que retorna, así
+            // que puede leer el color buffer sin copiarlo (con el borrado rápido activo, después de
+            // llamar a Rasterizer::resolve_clear()). Si la presentación necesita el contexto
+            // de OpenGL, debe copiar los píxeles y dejar que los suba el hilo que lo tiene:
+
+            typedef std::function< void (Rasterizer & , unsigned frame) > Present;
+
+        private:
+
+            Rasterizer                & rasterizer;
+            Thread_Pool               & thread_pool;
+            Present                     present;
+
+            std::vector< Frame_Bins >   frames;             // Uno por cada frame en vuelo
+
+            std::mutex                  mutex;
+            std::condition_variable     frame_recorded;
+            std::condition_variable     frame_presented;
+
+            unsigned                    recorded_frames;    // Frames entregados con end_frame()
+            unsigned                    presented_frames;   // Frames rellenados y presentados
+            bool                        recording;
+            bool                        exiting;
+
+            std::thread                 render_thread;
+
+        public:
+
+            Frame_Pipeline(Rasterizer & rasterizer, Thread_Pool & thread_pool, Present present, unsigned max_frames_in_flight = 2)
+            :
+                rasterizer      (rasterizer),
+                thread_pool     (thread_pool),
+                present         (std::move (present)),
+                frames          (std::max (max_frames_in_flight, 1u)),
+                recorded_frames (0),
+                presented_frames(0),
+                recording       (false),
+                exiting         (false)
+            {
+                render_thread = std::thread(&Frame_Pipeline::render_loop, this);
+            }
+
+           ~Frame_Pipeline()
+            {
+                finish ();
+
+                {
+                    std::lock_guard< std::mutex > lock(mutex);
+                    exiting = true;
+                }
+
+                frame_recorded.notify_all ();
+
+                render_thread.join ();
+            }
+
+            Frame_Pipeline(const Frame_Pipeline & ) = delete;
+            Frame_Pipeline & operator = (const Frame_Pipeline & ) = delete;
+
+        public:
+
+            unsigned get_max_frames_in_flight () const
+            {
+                return unsigned(frames.size ());
+            }
+
+            /** Espera a que quede libre un Frame_Bins y empieza a grabar en él. Devuelve el número
+              * del frame. Hasta end_frame() se puede dibujar en el rasterizer como en el modo
+              * inmediato, empezando normalmente por clear().
+              */
+            unsigned begin_frame ()
+            {
+                assert(!recording);
+
+                unsigned frame;
+
+                {
+                    std::unique_lock< std::mutex > lock(mutex);
+
+                    frame_presented.wait (lock, [this] () { return recorded_frames - presented_frames < frames.size (); });
+
+                    frame = recorded_frames;
+                }
+
+                rasterizer.begin_recording (frames[frame % frames.size ()]);
+
+                recording = true;
+
+                return frame;
+            }
+
+            // Termina la grabación y deja el frame en la cola del hilo de rasterizado:
+
+            void end_frame ()
+            {
+                assert(recording);
+
+                rasterizer.end_recording ();
+
+                recording = false;
+
+                {
+                    std::lock_guard< std::mutex > lock(mutex);
+                    recorded_frames++;
+                }
+
+                frame_recorded.notify_one ();
+            }
+
+            // Espera a que se hayan presentado todos los frames entregados. Después se puede volver
+            // a cambiar la configuración del rasterizer:
+
+            void finish ()
+            {
+                assert(!recording);
+
+                std::unique_lock< std::mutex > lock(mutex);
+
+                frame_presented.wait (lock, [this] () { return presented_frames == recorded_frames; });
+            }
+
+        private:
+
+            void render_loop ()
+            {
+                while (true)
+                {
+                    unsigned frame;
+
+                    {
+                        std::unique_lock< std::mutex > lock(mutex);
+
+                        frame_recorded.wait (lock, [this] () { return exiting || presented_frames != recorded_frames; });
+
+                        if (presented_frames == recorded_frames) return;
+
+                        frame = presented_frames;
+                    }
+
+                    // Los bins de este frame ya no se tocan desde el otro hilo hasta que se marque
+                    // como presentado:
+
+                    rasterizer.render_bins (frames[frame % frames.size ()], thread_pool);
+
+                    if (present) present (rasterizer, frame);
+
+                    {
+                        std::lock_guard< std::mutex > lock(mutex);
+                        presented_frames++;
+                    }
+
+                    frame_presented.notify_all ();
+                }
+            }
+
+        };
+
+    }
+
+#endif
@@ -43,6 +43,16 @@ void Mesh::load_mesh(const std::string& mesh_file_path) {
 
 		size_t number_of_vertices = mesh->mNumVertices;
 
+		// Keep the positions and their bounding box for occlusion culling
+		positions.resize(number_of_vertices);
+		bounding_box_min = bounding_box_max = number_of_vertices ? vec3(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z) : vec3(0.f);
+
+		for (size_t i = 0; i < number_of_vertices; ++i) {
+			positions[i] = vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+			bounding_box_min = glm::min(bounding_box_min, positions[i]);
+			bounding_box_max = glm::max(bounding_box_max, positions[i]);
+		}
+
 		glBindVertexArray(vao_id);
 
 		static_assert(sizeof(aiVector3D) == sizeof(fvec3), "aiVector3D should composed of three floats");
@@ -81,7 +91,7 @@ void Mesh::load_mesh(const std::string& mesh_file_path) {
 
 		number_of_indices = mesh->mNumFaces * 3;
 
-		std::vector< GLshort > indices(number_of_indices);
+		indices.resize(number_of_indices);
 
 		auto vertex_index = indices.begin();
 
@@ -97,7 +107,7 @@ void Mesh::load_mesh(const std::string& mesh_file_path) {
 		}
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_ids[INDICES_EBO]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLshort), indices.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
 	}
 }
 
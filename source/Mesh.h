@@ -2,6 +2,7 @@
 #include "Node.h"
 #include "MeshData.h"
 #include <string>
+#include <vector>
 #include "Camera.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -20,8 +21,17 @@ public:
     GLuint getVaoId() const { return vao_id; } 
     void setName(const std::string& name) { meshName = name; }
     std::string getName() const { return meshName; }
+    // CPU copies used by the occlusion culler
+    const vec3& getBoundingBoxMin() const { return bounding_box_min; }
+    const vec3& getBoundingBoxMax() const { return bounding_box_max; }
+    const std::vector<vec3>& getPositions() const { return positions; }
+    const std::vector<GLushort>& getIndices() const { return indices; }
 private:
     std::string meshName;
+    vec3 bounding_box_min;
+    vec3 bounding_box_max;
+    std::vector<vec3> positions;
+    std::vector<GLushort> indices;
     GLuint vao_id;
     GLuint vbo_ids[VBO_COUNT];
     GLuint number_of_indices;
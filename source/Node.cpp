@@ -1,29 +1,42 @@
 #include "Node.h"
 #include "Mesh.h"
+#include "Occlusion_Culler.hpp"
 
 using namespace example;
 
-void Node::render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, GLuint textureId) {
+void Node::render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, GLuint textureId, const Occlusion_Culler* culler) {
     glm::mat4 model_view_matrix = view_matrix * transformation;
-    if (mesh) {
+    if (mesh && (!culler || culler->is_visible(model_view_matrix, mesh->getBoundingBoxMin(), mesh->getBoundingBoxMax()))) {
         glBindVertexArray(mesh->getVaoId());
         glUniformMatrix4fv(model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
         mesh->render(textureId);
     }
     for (auto& child : children) {
-        child->render(model_view_matrix_id, model_view_matrix, textureId);
+        child->render(model_view_matrix_id, model_view_matrix, textureId, culler);
     }
 }
 
-void Node::render(GLuint model_view_matrix_id, const glm::mat4& view_matrix) {
+void Node::render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, const Occlusion_Culler* culler) {
     glm::mat4 model_view_matrix = view_matrix * transformation;
-    if (mesh) {
+    if (mesh && (!culler || culler->is_visible(model_view_matrix, mesh->getBoundingBoxMin(), mesh->getBoundingBoxMax()))) {
         glBindVertexArray(mesh->getVaoId());
         glUniformMatrix4fv(model_view_matrix_id, 1, GL_FALSE, glm::value_ptr(model_view_matrix));
         mesh->render();
     }
     for (auto& child : children) {
-        child->render(model_view_matrix_id, model_view_matrix);
+        child->render(model_view_matrix_id, model_view_matrix, culler);
+    }
+}
+
+void Node::collect_occluders(Occlusion_Culler& culler, const glm::mat4& view_matrix) const {
+    glm::mat4 model_view_matrix = view_matrix * transformation;
+    if (mesh && occluder) {
+        const auto& positions = mesh->getPositions();
+        const auto& indices = mesh->getIndices();
+        culler.add_occluder(model_view_matrix, positions.data(), positions.size(), indices.data(), indices.size());
+    }
+    for (auto& child : children) {
+        child->collect_occluders(culler, model_view_matrix);
     }
 }
 void Node::addChild(std::shared_ptr<Node> child)
@@ -6,6 +6,7 @@
 
 using namespace example;
 class Mesh;
+namespace example { class Occlusion_Culler; }
 
 class Node : public std::enable_shared_from_this<Node>
 {
@@ -17,6 +18,10 @@ public:
 
     std::shared_ptr<Mesh> mesh; 
 
+    // Occluder meshes are rasterized into the occlusion culler depth buffer each frame. Only
+    // opaque meshes may be occluders: anything seen through a blended mesh would be culled
+    bool occluder = false;
+
     Node(const glm::mat4& transformation = glm::mat4(1.0f))
         : transformation(transformation)
     {}
@@ -29,8 +34,11 @@ public:
 
     void addChild(std::shared_ptr<Node> child);
 
-    void render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, GLuint textureId);
+    // With a culler, meshes whose bounding box is hidden behind the occluders are not drawn
+    void render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, GLuint textureId, const Occlusion_Culler* culler = nullptr);
     // When we dont have textures
-    void render(GLuint model_view_matrix_id, const glm::mat4& view_matrix);
+    void render(GLuint model_view_matrix_id, const glm::mat4& view_matrix, const Occlusion_Culler* culler = nullptr);
+    // Adds the meshes of the occluder nodes of this subtree to the culler
+    void collect_occluders(Occlusion_Culler& culler, const glm::mat4& view_matrix) const;
     void reset_transformation();
 };
\ No newline at end of file
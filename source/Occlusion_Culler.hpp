@@ -0,0 +1,464 @@
+// Este código es de dominio público.
+
+#ifndef OCCLUSION_CULLER_HEADER
+#define OCCLUSION_CULLER_HEADER
+
+    #include <algorithm>
+    #include <cmath>
+    #include <cstddef>
+    #include <cstdint>
+    #include <limits>
+    #include <vector>
+    #include "math.hpp"
+    #include "simd.hpp"
+    #include "Thread_Pool.hpp"
+
+    namespace example
+    {
+
+        /** Culling de oclusión por software. Cada frame se rasterizan los triángulos de los
+          * oclusores designados en un z-buffer de baja resolución y después se comprueba contra
+          * él la caja envolvente de cada objeto antes de mandarlo a dibujar, sin esperar a la GPU.
+          *
+          * Las profundidades son z / w en coordenadas normalizadas (menor es más cercano). Cada
+          * triángulo oclusor escribe la profundidad de su vértice más lejano en los píxeles cuyo
+          * centro cubre. Los empates cuentan como dentro, así que dos triángulos que comparten
+          * una arista no dejan huecos entre ellos. Después cada píxel se queda con la profundidad
+          * más lejana de sus 3x3 vecinos, de modo que un píxel que el oclusor no cubre entero (en
+          * el borde de su silueta o donde se juntan triángulos a distinta profundidad) recibe la
+          * del hueco o la del triángulo más lejano. Cada caja se prueba con la profundidad de su
+          * esquina más cercana en todos los píxeles que toca, aunque sea en parte.
+          *
+          * El resultado es conservador salvo con detalles de los oclusores más finos que un píxel
+          * (rendijas, agujeros o triángulos muy estrechos), que el muestreo puede no ver.
+          */
+        class Occlusion_Culler
+        {
+        public:
+
+            // Filas de cada tarea al construir el z-buffer con varios hilos:
+
+            static constexpr unsigned band_height = 16;
+
+            // Los vértices con w menor que esta cota se consideran detrás de la cámara:
+
+            static constexpr float minimum_w = 1e-5f;
+
+            // Los triángulos con algún vértice a más de esta distancia (en píxeles) de la pantalla
+            // se descartan, porque con coordenadas tan grandes las aristas en float pierden la
+            // precisión necesaria para que la cobertura sea fiable:
+
+            static constexpr float guard_band = 65536.f;
+
+        private:
+
+            // Triángulo oclusor preparado: coeficientes de sus tres aristas (a·x + b·y + c, que
+            // es positivo en el interior), profundidad con la que se escribe y rectángulo de
+            // píxeles que puede tocar:
+
+            struct Occluder_Triangle
+            {
+                float a[3], b[3], c[3];
+                float depth;
+                int   min_x, max_x;
+                int   min_y, max_y;
+            };
+
+        private:
+
+            unsigned width;
+            unsigned height;
+            unsigned pitch;                             // width redondeado a múltiplo de 8
+
+            std::vector< float > coverage_buffer;       // Profundidad en el centro de cada píxel
+            std::vector< float > depth_buffer;          // Profundidad conservadora (máximo de 3x3)
+
+            Matrix44 projection;
+
+            std::vector< Occluder_Triangle > triangles;
+
+        public:
+
+            Occlusion_Culler(unsigned width = 256, unsigned height = 128)
+            :
+                width       (width),
+                height      (height),
+                pitch       ((width + 7) & ~7u),
+                coverage_buffer(size_t(pitch) * height, std::numeric_limits< float >::max ()),
+                depth_buffer   (size_t(pitch) * height, std::numeric_limits< float >::max ()),
+                projection  (1.f)
+            {
+            }
+
+            unsigned get_width () const
+            {
+                return width;
+            }
+
+            unsigned get_height () const
+            {
+                return height;
+            }
+
+            const float * get_depth_buffer () const
+            {
+                return depth_buffer.data ();
+            }
+
+            unsigned get_occluder_triangle_count () const
+            {
+                return unsigned(triangles.size ());
+            }
+
+        public:
+
+            /** Descarta los oclusores del frame anterior y fija la proyección del nuevo.
+              */
+            void begin_frame (const Matrix44 & projection_matrix)
+            {
+                projection = projection_matrix;
+
+                triangles.clear ();
+            }
+
+            /** Añade los triángulos de una malla oclusora. model_view lleva sus vértices a
+              * coordenadas de cámara. Se descartan los triángulos que cruzan el plano cercano (y
+              * con él el de la cámara), lo que solo hace que ocluyan menos.
+              */
+            template< typename INDEX >
+            void add_occluder
+            (
+                const Matrix44  & model_view,
+                const Vector3f  * vertices,
+                size_t            vertex_count,
+                const INDEX     * indices,
+                size_t            index_count
+            );
+
+            /** Rasteriza los oclusores añadidos desde begin_frame() y calcula a partir de ellos el
+              * z-buffer conservador. Con thread_pool cada worker procesa franjas de band_height filas.
+              */
+            void build (Thread_Pool * thread_pool = nullptr);
+
+            /** Indica si alguna parte de la caja [box_min, box_max] (en coordenadas del modelo)
+              * puede quedar a la vista. model_view lleva la caja a coordenadas de cámara.
+              */
+            bool is_visible (const Matrix44 & model_view, const Vector3f & box_min, const Vector3f & box_max) const;
+
+        private:
+
+            void rasterize_band (unsigned band_begin, unsigned band_end);
+
+            void filter_band    (unsigned band_begin, unsigned band_end);
+
+            Vector3f to_screen (const Vector4f & clip) const
+            {
+                const float inverse_w = 1.f / clip.w;
+
+                return Vector3f
+                (
+                    (clip.x * inverse_w * 0.5f + 0.5f) * float(width ),
+                    (clip.y * inverse_w * 0.5f + 0.5f) * float(height),
+                     clip.z * inverse_w
+                );
+            }
+
+            bool outside_guard_band (const Vector3f & point) const
+            {
+                return !(point.x > -guard_band && point.x < float(width ) + guard_band &&
+                         point.y > -guard_band && point.y < float(height) + guard_band);
+            }
+
+        };
+
+        template< typename INDEX >
+        void Occlusion_Culler::add_occluder
+        (
+            const Matrix44  & model_view,
+            const Vector3f  * vertices,
+            size_t            vertex_count,
+            const INDEX     * indices,
+            size_t            index_count
+        )
+        {
+            const Matrix44 transformation = projection * model_view;
+
+            std::vector< Vector4f > clip(vertex_count);
+
+            for (size_t index = 0; index < vertex_count; ++index)
+            {
+                clip[index] = transformation * Vector4f(vertices[index], 1.f);
+            }
+
+            for (size_t index = 0; index + 2 < index_count; index += 3)
+            {
+                const Vector4f & c0 = clip[size_t(indices[index + 0])];
+                const Vector4f & c1 = clip[size_t(indices[index + 1])];
+                const Vector4f & c2 = clip[size_t(indices[index + 2])];
+
+                if (c0.w < minimum_w || c1.w < minimum_w || c2.w < minimum_w) continue;
+
+                // Un vértice entre la cámara y el plano cercano también se proyecta, pero esa parte
+                // del triángulo no llega a dibujarse y lo que queda detrás sí se ve:
+
+                if (c0.z < -c0.w || c1.z < -c1.w || c2.z < -c2.w) continue;
+
+                Vector3f p0 = to_screen (c0);
+                Vector3f p1 = to_screen (c1);
+                Vector3f p2 = to_screen (c2);
+
+                // Se rasterizan ambas caras. Las que giran en sentido horario se invierten para
+                // que las aristas sean positivas en el interior:
+
+                float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+
+                if (!(std::abs (area) > 0.f)) continue;
+
+                if (outside_guard_band (p0) || outside_guard_band (p1) || outside_guard_band (p2)) continue;
+
+                if (area < 0.f) std::swap (p1, p2);
+
+                Occluder_Triangle triangle;
+
+                triangle.min_x = std::max (int(std::floor (std::min ({ p0.x, p1.x, p2.x }))), 0);
+                triangle.max_x = std::min (int(std::ceil  (std::max ({ p0.x, p1.x, p2.x }))), int(width ));
+                triangle.min_y = std::max (int(std::floor (std::min ({ p0.y, p1.y, p2.y }))), 0);
+                triangle.max_y = std::min (int(std::ceil  (std::max ({ p0.y, p1.y, p2.y }))), int(height));
+
+                if (triangle.min_x >= triangle.max_x || triangle.min_y >= triangle.max_y) continue;
+
+                const Vector3f * corners[] = { &p0, &p1, &p2 };
+
+                for (int edge = 0; edge < 3; ++edge)
+                {
+                    const Vector3f & a = *corners[edge];
+                    const Vector3f & b = *corners[(edge + 1) % 3];
+
+                    triangle.a[edge] = a.y - b.y;
+                    triangle.b[edge] = b.x - a.x;
+                    triangle.c[edge] = a.x * b.y - a.y * b.x;
+                }
+
+                triangle.depth = std::max ({ p0.z, p1.z, p2.z });
+
+                triangles.push_back (triangle);
+            }
+        }
+
+        inline void Occlusion_Culler::build (Thread_Pool * thread_pool)
+        {
+            const unsigned band_count = (height + band_height - 1) / band_height;
+
+            // El filtro de cada franja lee la fila anterior y la siguiente, por lo que no empieza
+            // hasta que se han rasterizado todas las franjas:
+
+            if (thread_pool && band_count > 1)
+            {
+                thread_pool->run
+                (
+                    band_count,
+                    [&] (unsigned , unsigned band)
+                    {
+                        rasterize_band (band * band_height, std::min ((band + 1) * band_height, height));
+                    }
+                );
+
+                thread_pool->run
+                (
+                    band_count,
+                    [&] (unsigned , unsigned band)
+                    {
+                        filter_band (band * band_height, std::min ((band + 1) * band_height, height));
+                    }
+                );
+            }
+            else
+            {
+                rasterize_band (0, height);
+                filter_band    (0, height);
+            }
+        }
+
+        inline void Occlusion_Culler::rasterize_band (unsigned band_begin, unsigned band_end)
+        {
+            using simd::Int32x8;
+            using simd::Float32x8;
+
+            static const float lane_offsets[8] = { .5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+
+            const Float32x8 offsets = Float32x8::load (lane_offsets);
+
+            std::fill
+            (
+                coverage_buffer.begin () + size_t(band_begin) * pitch,
+                coverage_buffer.begin () + size_t(band_end  ) * pitch,
+                std::numeric_limits< float >::max ()
+            );
+
+            for (const Occluder_Triangle & triangle : triangles)
+            {
+                const int y_begin = std::max (triangle.min_y, int(band_begin));
+                const int y_end   = std::min (triangle.max_y, int(band_end  ));
+
+                if (y_begin >= y_end) continue;
+
+                const Float32x8 depth = Float32x8::set1 (triangle.depth);
+                const Float32x8 a0    = Float32x8::set1 (triangle.a[0]);
+                const Float32x8 a1    = Float32x8::set1 (triangle.a[1]);
+                const Float32x8 a2    = Float32x8::set1 (triangle.a[2]);
+
+                // Los bloques de 8 píxeles van alineados con las filas, que miden pitch, por lo que
+                // el último bloque de una fila nunca se sale de ella:
+
+                const int x_begin = triangle.min_x & ~7;
+
+                for (int y = y_begin; y < y_end; ++y)
+                {
+                    const float center_y = float(y) + .5f;
+
+                    const Float32x8 row0 = Float32x8::set1 (triangle.b[0] * center_y + triangle.c[0]);
+                    const Float32x8 row1 = Float32x8::set1 (triangle.b[1] * center_y + triangle.c[1]);
+                    const Float32x8 row2 = Float32x8::set1 (triangle.b[2] * center_y + triangle.c[2]);
+
+                    float * row = coverage_buffer.data () + size_t(y) * pitch;
+
+                    for (int x = x_begin; x < triangle.max_x; x += 8)
+                    {
+                        const Float32x8 center_x = Float32x8::set1 (float(x)) + offsets;
+
+                        // Un píxel está cubierto si su centro no queda en el lado negativo de
+                        // ninguna arista, es decir, si no se activa el bit de signo de ninguna:
+
+                        const Int32x8 outside = Int32x8::negative
+                        (
+                            (a0 * center_x + row0).to_bits () |
+                            (a1 * center_x + row1).to_bits () |
+                            (a2 * center_x + row2).to_bits ()
+                        );
+
+                        if (Int32x8::bits (outside) == 0xFF) continue;
+
+                        const Float32x8 stored  = Float32x8::load (row + x);
+                        const Int32x8   updated = Int32x8::select (outside, Float32x8::min (stored, depth).to_bits (), stored.to_bits ());
+
+                        updated.store (reinterpret_cast< int32_t * >(row + x));
+                    }
+                }
+            }
+        }
+
+        inline void Occlusion_Culler::filter_band (unsigned band_begin, unsigned band_end)
+        {
+            using simd::Float32x8;
+
+            // Máximo vertical de cada fila con sus vecinas, con un elemento más a cada lado para
+            // hacer el máximo horizontal con lecturas desplazadas. Los bordes de la pantalla
+            // repiten la fila o la columna del borde, ya que lo que queda fuera no se prueba:
+
+            std::vector< float > column_max(size_t(pitch) + 2);
+
+            for (unsigned y = band_begin; y < band_end; ++y)
+            {
+                const float * above = coverage_buffer.data () + size_t(y > 0          ? y - 1 : y) * pitch;
+                const float * row   = coverage_buffer.data () + size_t(y                          ) * pitch;
+                const float * below = coverage_buffer.data () + size_t(y + 1 < height ? y + 1 : y) * pitch;
+
+                for (unsigned x = 0; x < pitch; x += 8)
+                {
+                    Float32x8::max
+                    (
+                        Float32x8::max (Float32x8::load (above + x), Float32x8::load (row + x)),
+                        Float32x8::load (below + x)
+                    )
+                    .store (column_max.data () + x + 1);
+                }
+
+                column_max[0        ] = column_max[1    ];
+                column_max[width + 1] = column_max[width];
+
+                float * depth = depth_buffer.data () + size_t(y) * pitch;
+
+                for (unsigned x = 0; x < pitch; x += 8)
+                {
+                    Float32x8::max
+                    (
+                        Float32x8::max (Float32x8::load (column_max.data () + x), Float32x8::load (column_max.data () + x + 1)),
+                        Float32x8::load (column_max.data () + x + 2)
+                    )
+                    .store (depth + x);
+                }
+            }
+        }
+
+        inline bool Occlusion_Culler::is_visible (const Matrix44 & model_view, const Vector3f & box_min, const Vector3f & box_max) const
+        {
+            using simd::Int32x8;
+            using simd::Float32x8;
+
+            const Matrix44 transformation = projection * model_view;
+
+            float min_x =  std::numeric_limits< float >::max (), max_x = -std::numeric_limits< float >::max ();
+            float min_y =  std::numeric_limits< float >::max (), max_y = -std::numeric_limits< float >::max ();
+            float nearest = std::numeric_limits< float >::max ();
+
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const Vector4f clip = transformation * Vector4f
+                (
+                    corner & 1 ? box_max.x : box_min.x,
+                    corner & 2 ? box_max.y : box_min.y,
+                    corner & 4 ? box_max.z : box_min.z,
+                    1.f
+                );
+
+                // Si la caja cruza el plano de la cámara no se puede proyectar y se da por visible:
+
+                if (clip.w < minimum_w) return true;
+
+                const Vector3f point = to_screen (clip);
+
+                min_x   = std::min (min_x, point.x);  max_x = std::max (max_x, point.x);
+                min_y   = std::min (min_y, point.y);  max_y = std::max (max_y, point.y);
+                nearest = std::min (nearest, point.z);
+            }
+
+            // Se prueban todos los píxeles que la caja toca, aunque no cubra su centro:
+
+            const int x_begin = int(std::floor (std::max (min_x, 0.f          )));
+            const int x_end   = int(std::ceil  (std::min (max_x, float(width ))));
+            const int y_begin = int(std::floor (std::max (min_y, 0.f          )));
+            const int y_end   = int(std::ceil  (std::min (max_y, float(height))));
+
+            // Una caja fuera de la pantalla no se ve:
+
+            if (x_begin >= x_end || y_begin >= y_end) return false;
+
+            const Float32x8 box_depth = Float32x8::set1 (nearest);
+
+            for (int y = y_begin; y < y_end; ++y)
+            {
+                const float * row = depth_buffer.data () + size_t(y) * pitch;
+
+                for (int x = x_begin & ~7; x < x_end; x += 8)
+                {
+                    // Carriles del bloque que caen dentro del rectángulo de la caja:
+
+                    unsigned lanes = 0xFF;
+
+                    if (x     < x_begin) lanes &= 0xFFu << (x_begin - x);
+                    if (x + 8 > x_end  ) lanes &= 0xFFu >> (x + 8 - x_end);
+
+                    // La caja asoma en los carriles en los que el z-buffer no queda delante:
+
+                    const Int32x8 hidden = Int32x8::negative ((Float32x8::load (row + x) - box_depth).to_bits ());
+
+                    if (~Int32x8::bits (hidden) & lanes) return true;
+                }
+            }
+
+            return false;
+        }
+
+    }
+
+#endif
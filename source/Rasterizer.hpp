@@ -7,384 +7,3060 @@
 #define RASTERIZER_HEADER
 
     #include <algorithm>
+    #include <cassert>
     #include <ciso646>
+    #include <cmath>
     #include <cstdint>
     #include <limits>
+    #include <type_traits>
+    #include <vector>
+    #include "blend_functions.hpp"
+    #include "Clipper.hpp"
+    #include "Depth_Formats.hpp"
     #include "math.hpp"
+    #include "MeshData.h"
+    #include "simd.hpp"
+    #include "Texture.hpp"
+    #include "Thread_Pool.hpp"
 
     namespace example
     {
 
-        template< class COLOR_BUFFER_TYPE >
+        // DEPTH_FORMAT elige el formato del z-buffer entre los de Depth_Formats.hpp:
+
+        template< class COLOR_BUFFER_TYPE, class DEPTH_FORMAT = Depth_Int32 >
         class Rasterizer
         {
         public:
 
-            typedef COLOR_BUFFER_TYPE            Color_Buffer;
-            typedef typename Color_Buffer::Color Color;
+            typedef COLOR_BUFFER_TYPE                  Color_Buffer;
+            typedef typename Color_Buffer::Color       Color;
+            typedef DEPTH_FORMAT                       Depth_Format;
+            typedef typename Depth_Format::Value       Depth_Value;
+            typedef typename Depth_Format::Interpolant Depth_Interpolant;
+            typedef example::Texture< Color >          Texture;
+
+            static constexpr int tile_size   = 64;      // Lado en píxeles de los tiles del modo binned
+            static constexpr int z_tile_size =  8;      // Lado en píxeles de los tiles del z-buffer jerárquico
+
+            // Algoritmos de relleno disponibles. SCANLINE recorre los lados del polígono y rellena
+            // una scanline tras otra. HALF_SPACE evalúa las funciones de arista y la profundidad
+            // en bloques de 8 píxeles con SIMD, lo que sale a cuenta con triángulos pequeños:
+
+            enum class Fill_Engine
+            {
+                SCANLINE,
+                HALF_SPACE
+            };
+
+            // Cómo se combina el color de los polígonos con el que ya tiene el color buffer. Cada modo
+            // corresponde a una función de blend_functions.hpp:
+
+            enum class Blend_Mode
+            {
+                REPLACE,                                // argb::blend_replace
+                HALF                                    // argb::blend_half
+            };
+
+            // Lo que guarda el visibility buffer en cada píxel. Los píxeles que no cubre ningún
+            // triángulo tienen triangle_id == no_triangle:
+
+            struct Visibility_Sample
+            {
+                uint32_t triangle_id;
+                uint32_t instance_id;
+            };
+
+            static constexpr uint32_t no_triangle = 0xFFFFFFFF;
+
+            static constexpr int msaa_samples = 4;
+
+            // Número máximo de atributos por vértice que se interpolan (ver set_vertex_attributes()):
+
+            static constexpr unsigned max_attributes = 12;
 
         private:
 
-            Color_Buffer & color_buffer;
+            // Cachés de lados. Cada rasterizer tiene las suyas y cada worker del modo binned también,
+            // de modo que varios rasterizers pueden trabajar a la vez desde hilos distintos. Se
+            // dimensionan con la altura del color buffer (más dos filas de holgura porque
+            // interpolate() escribe de dos en dos) y se reutilizan en todos los frames:
+
+            struct Edge_Cache
+            {
+                std::vector< int               > offset_cache0;
+                std::vector< int               > offset_cache1;
+                std::vector< Depth_Interpolant > z_cache0;
+                std::vector< Depth_Interpolant > z_cache1;
+
+                void resize (size_t rows)
+                {
+                    offset_cache0.resize (rows + 2);
+                    offset_cache1.resize (rows + 2);
+                    z_cache0     .resize (rows + 2);
+                    z_cache1     .resize (rows + 2);
+                }
+            };
+
+            struct Clip_Rectangle
+            {
+                int left, top, right, bottom;           // El borde derecho e inferior quedan fuera
+            };
+
+            // Triángulos de draw_indexed() que han superado el culling, con sus índices ya
+            // ordenados en sentido antihorario:
+
+            struct Triangle_Setup
+            {
+                int      indices[3];
+                uint32_t triangle_id;                   // Posición del triángulo en el index buffer del llamante
+            };
+
+            // Configuración de la etapa de sombreado. Los índices señalan el primer atributo de cada
+            // entrada (o son negativos si no se usa):
+
+            struct Shading
+            {
+                const Texture      * texture;           // Textura muestreada con (u, v) o nullptr
+                int                  uv_attribute;
+                int                  color_attribute;   // (r, g, b) normalizados que modulan el color
+                int                  normal_attribute;  // Normal con la que se ilumina el fragmento
+                Vector3f             light_direction;   // Dirección normalizada hacia la luz
+                float                ambient;
+            };
+
+            /* Preparación de los atributos de un polígono. 1/w y cada atributo dividido entre w son
+             * lineales en pantalla, así que se guardan como planos value + dx * (x - origin_x) +
+             * dy * (y - origin_y). Al sombrear se evalúan en el punto de cada píxel, se divide entre
+             * 1/w y se recupera el atributo con corrección de perspectiva. Se calculan en double una
+             * vez por polígono, de modo que el resultado no depende del tile que se rellena.
+             */
+
+            struct Attribute_Setup
+            {
+                Shading  shading;
+                int      origin_x;
+                int      origin_y;
+                unsigned count;                         // Atributos sin contar 1/w
+                double   value[max_attributes + 1];     // [0] es 1/w, el resto atributo / w
+                double   dx   [max_attributes + 1];
+                double   dy   [max_attributes + 1];
+            };
+
+            // Lo que se escribe en los píxeles que cubre un polígono: su color o, en el modo
+            // visibility buffer, su muestra de visibilidad. Si el polígono tiene atributos, el color
+            // de cada píxel se obtiene sombreándolo a partir de setup. Si depths no es nulo, tiene la
+            // profundidad de cada vértice (con los mismos índices) y sustituye a su z entera:
+
+            struct Fill_Value
+            {
+                Color                     color;
+                Visibility_Sample         sample;
+                const Attribute_Setup   * setup;
+                const Depth_Interpolant * depths;
+            };
+
+            /* Políticas de relleno. Fijan en tiempo de compilación lo que los algoritmos de relleno
+             * hacen con cada fragmento, de modo que cada combinación se compila como un kernel propio
+             * sin comprobaciones del estado en los bucles internos. El formato de color es el del
+             * color buffer.
+             *
+             *   depth_test     Solo se escriben los fragmentos más cercanos que el z-buffer.
+             *   depth_write    Los fragmentos que pasan el test guardan su profundidad.
+             *   color_write    Los fragmentos que pasan el test se escriben en el color buffer (o en
+             *                  el visibility buffer). Sin él solo se cuentan para las consultas.
+             *   blending       Si el color se combina con una función de blend_functions.hpp en lugar
+             *                  de reemplazarse, lo que impide rellenar los spans de una vez. BLEND es
+             *                  un Blend< función > o void para reemplazar.
+             *   shaded         Si el color de cada píxel se sombrea a partir de los atributos
+             *                  interpolados en lugar de ser el mismo en todo el polígono.
+             */
+
+            template< argb::blend_function< Color > BLEND_FUNCTION >
+            struct Blend
+            {
+                static void apply (Color & destination, const Color & source)
+                {
+                    BLEND_FUNCTION (destination, source);
+                }
+            };
+
+            template< bool DEPTH_TEST, bool DEPTH_WRITE, bool COLOR_WRITE, class BLEND = void, bool SHADED = false >
+            struct Fill_Policy
+            {
+                static_assert(DEPTH_TEST  || !DEPTH_WRITE, "depth writes require the depth test");
+                static_assert(COLOR_WRITE || !SHADED,      "shading requires color writes");
+
+                static constexpr bool depth_test  = DEPTH_TEST;
+                static constexpr bool depth_write = DEPTH_WRITE;
+                static constexpr bool color_write = COLOR_WRITE;
+                static constexpr bool blending    = !std::is_void< BLEND >::value;
+                static constexpr bool shaded      = SHADED;
+
+                static void blend (Color & destination, const Color & source)
+                {
+                    if constexpr (blending)
+                        BLEND::apply (destination, source);
+                    else
+                        destination = source;
+                }
+            };
+
+            // Política con los vectores de un nivel de argb::Cpu_Tier (uno de los simd::*_Tier). Cada
+            // kernel se instancia con todos los niveles compilados y select_tier_kernel() elige el
+            // que admite la CPU:
+
+            template< class POLICY, class SIMD_TIER >
+            struct Tiered_Policy : POLICY
+            {
+                typedef typename SIMD_TIER::Int32x8   Int32x8;
+                typedef typename SIMD_TIER::Float32x8 Float32x8;
+            };
+
+            // Kernel de relleno de polígonos convexos (una instancia de fill_convex_polygon_clipped()
+            // o de fill_convex_polygon_half_space() con una política). Se elige una vez por cada
+            // dibujo con select_kernel():
+
+            typedef void (Rasterizer::*Polygon_Kernel)
+            (
+                const Point4i        * const vertices,
+                const int            * const indices_begin,
+                const int            * const indices_end,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip,
+                Edge_Cache           &       cache
+            );
+
+            struct Binned_Polygon
+            {
+                int            first_vertex;            // Índice en Frame_Bins::vertices
+                int            vertex_count;
+                int            setup_index;             // Índice en Frame_Bins::setups o -1
+                int            first_depth;             // Índice en Frame_Bins::depths o -1
+                Fill_Value     fill;
+                Polygon_Kernel kernel;
+            };
+
+        public:
+
+            /** Polígonos de un frame repartidos por los tiles que toca su bounding box. Entre
+              * begin_recording() y end_recording() los polígonos se graban en unos Frame_Bins en
+              * lugar de rellenarse, y render_bins() los rellena más tarde, incluso desde otro hilo
+              * mientras se graba el frame siguiente en otros Frame_Bins. Un clear() durante la
+              * grabación también se guarda y se aplica antes de rellenar.
+              */
+            class Frame_Bins
+            {
+                friend class Rasterizer;
+
+                std::vector< Point4i >            vertices;
+                std::vector< Depth_Interpolant >  depths;
+                std::vector< Binned_Polygon >     polygons;
+                std::vector< Attribute_Setup >    setups;
+                std::vector< std::vector< int > > tiles;
+                std::vector< int >                sequential_indices;
+                bool                              clear_requested = false;
+                Color                             clear_color;
+
+                // Se vacían los bins conservando su capacidad para el siguiente frame:
+
+                void reset (size_t tile_count)
+                {
+                    tiles.resize (tile_count);
+
+                    for (auto & tile : tiles) tile.clear ();
+
+                    vertices.clear ();
+                    depths  .clear ();
+                    polygons.clear ();
+                    setups  .clear ();
+
+                    clear_requested = false;
+                }
+
+            public:
+
+                bool empty () const
+                {
+                    return polygons.empty () && !clear_requested;
+                }
+            };
+
+        private:
 
-            static int offset_cache0[2160];
-            static int offset_cache1[2160];
+            Color_Buffer & color_buffer;
 
-            static int z_cache0[2160];
-            static int z_cache1[2160];
+            Edge_Cache     edge_cache;
 
             Color color;
 
-            std::vector< int > z_buffer;
+            std::vector< Depth_Value > z_buffer;
+
+            Fill_Engine        fill_engine;
+            Blend_Mode         blend_mode;
+            bool               depth_write;
+
+            bool                          backface_culling;
+            std::vector< Triangle_Setup > triangle_setups;
+
+            // Recorte de draw_indexed (MeshData &). Con atributos, los del llamante se copian y se
+            // amplían con los de los vértices que crea el recorte. Con un z-buffer float también se
+            // guarda la profundidad de cada vértice calculada con sus coordenadas de clip:
+
+            Clipper                          clipper;
+            Index_Buffer                     clipped_indices;
+            std::vector< float >             clipped_attributes;
+            std::vector< float >             clipped_inverse_w;
+            std::vector< Depth_Interpolant > clipped_depths;
+
+            // Nivel grueso del z-buffer: para cada tile de 8x8 se guarda la profundidad más lejana
+            // que contiene. Un polígono cuya profundidad más cercana no está por delante de esa
+            // cota no puede pasar el test en ningún píxel del tile. La cota se mantiene de forma
+            // perezosa: al escribir solo se marca el tile y se recalcula cuando un polígono nuevo
+            // la va a consultar.
+
+            bool                       hierarchical_z;
+            int                        z_tile_columns;
+            int                        z_tile_rows;
+            std::vector< Depth_Value > z_tile_farthest;
+            std::vector< uint8_t     > z_tile_dirty;
+
+            // Borrado rápido (si fast_clear está activo): clear() no escribe ni en el color buffer
+            // ni en el z-buffer, solo marca los tiles de 8x8 como borrados. El primer polígono que
+            // rellena algún píxel de un tile marcado lo borra de verdad antes de escribir (y
+            // resolve_clear() borra los que quedan), así que los tiles que no se tocan en todo el
+            // frame no cuestan nada. Sin él, clear() borra todos los tiles en el momento:
+
+            bool                       fast_clear;
+            Color                      clear_color;
+            bool                       clear_pending;
+            std::vector< uint8_t     > z_tile_cleared;
+
+            // Modo visibility buffer: el relleno no escribe colores, sino el triángulo y la instancia
+            // que quedan visibles en cada píxel. Después resolve_visibility() sombrea una sola vez
+            // cada píxel cubierto, por mucho overdraw que haya habido:
+
+            bool                             visibility_mode;
+            std::vector< Visibility_Sample > visibility_buffer;
+            uint32_t                         triangle_id;
+            uint32_t                         instance_id;
+
+            /* Multisampling 4x. Cada píxel tiene cuatro muestras de profundidad (contiguas), pero
+             * normalmente un solo color, que se guarda en el propio color buffer: cada triángulo
+             * escribe un único color en las muestras que cubre y, si pasa el test en las cuatro,
+             * el píxel queda comprimido. Solo los píxeles de los bordes, cuyas muestras tienen
+             * colores distintos, se expanden a un bloque de cuatro colores de msaa_pools, que
+             * tiene un pool por cada tile del modo binned para que cada worker solo toque el suyo.
+             *
+             * msaa_blocks guarda para cada píxel el índice de su bloque en el pool de su tile (o
+             * no_msaa_block) y msaa_expanded_bit si está expandido. Un píxel que vuelve a quedar
+             * comprimido conserva el bloque para reutilizarlo, y los pools se vacían con clear().
+             * En total, el MSAA ocupa cuatro profundidades y 4 bytes por píxel, más cuatro colores
+             * por cada píxel de borde, en lugar de cuatro colores por píxel.
+             */
+
+            static constexpr uint32_t msaa_expanded_bit = 0x80000000u;       // find_high_bit() lo busca
+            static constexpr uint32_t no_msaa_block     = 0x7FFFFFFFu;
+            static constexpr int      resolve_run_size  = 64;                // Píxeles que resolve_msaa() promedia a la vez
+
+            bool                                msaa;
+            std::vector< Depth_Value >          msaa_depths;
+            std::vector< uint32_t    >          msaa_blocks;
+            std::vector< std::vector< Color > > msaa_pools;
+
+            // Consultas de oclusión. Mientras hay una abierta se cuentan los fragmentos (o muestras,
+            // con MSAA) que pasan el test de profundidad. Con depth_test_only activo los polígonos
+            // no escriben ni color ni profundidad, así que se puede comprobar si algo es visible
+            // (por ejemplo, la bounding box de un nodo) sin alterar la imagen:
+
+            bool                       depth_test_only;
+            bool                       query_active;
+            uint64_t                   query_fragments;
+
+            // Atributos de los vértices y configuración de la etapa de sombreado. Sin atributos los
+            // polígonos se rellenan con un color plano:
+
+            const float              * attribute_values;
+            const float              * attribute_inverse_w;
+            unsigned                   attribute_count;
+            Shading                    shading;
+
+            // Estado del modo binned. Los polígonos recibidos entre begin_binning() y end_binning()
+            // se copian y se reparten entre los tiles que toca su bounding box. Al terminar, cada
+            // tile lo rellena un único worker, por lo que no hace falta sincronizar el acceso al
+            // color buffer ni al z-buffer. bins apunta a los Frame_Bins que se están grabando:
+            // own_bins en el modo binned o los que se pasan a begin_recording().
+
+            Thread_Pool                     * thread_pool;
+            int                               tile_columns;
+            int                               tile_rows;
+            Frame_Bins                        own_bins;
+            Frame_Bins                      * bins;
+            std::vector< Edge_Cache >         worker_caches;
 
         public:
 
             Rasterizer(Color_Buffer & target)
             :
                 color_buffer(target),
-                z_buffer(target.get_width () * target.get_height ())
+                z_buffer    (target.get_pitch () * target.get_height (), Depth_Format::far_value ()),
+                fill_engine (Fill_Engine::SCANLINE),
+                blend_mode  (Blend_Mode::REPLACE),
+                depth_write (true),
+                backface_culling(true),
+                clipper     (target.get_width (), target.get_height ()),
+                hierarchical_z(true),
+                z_tile_columns((int(target.get_width  ()) + z_tile_size - 1) / z_tile_size),
+                z_tile_rows   ((int(target.get_height ()) + z_tile_size - 1) / z_tile_size),
+                z_tile_farthest(size_t(z_tile_columns * z_tile_rows), Depth_Format::far_value ()),
+                z_tile_dirty  (size_t(z_tile_columns * z_tile_rows), 0),
+                fast_clear    (false),
+                clear_pending (false),
+                z_tile_cleared(size_t(z_tile_columns * z_tile_rows), 0),
+                visibility_mode(false),
+                triangle_id (0),
+                instance_id (0),
+                msaa        (false),
+                depth_test_only(false),
+                query_active   (false),
+                query_fragments(0),
+                attribute_values   (nullptr),
+                attribute_inverse_w(nullptr),
+                attribute_count    (0),
+                shading            { nullptr, -1, -1, -1, Vector3f(0.f, 0.f, 1.f), 0.f },
+                thread_pool (nullptr),
+                tile_columns((int(target.get_width  ()) + tile_size - 1) / tile_size),
+                tile_rows   ((int(target.get_height ()) + tile_size - 1) / tile_size),
+                bins        (nullptr)
+            {
+                edge_cache.resize (target.get_height ());
+            }
+
+            // Con el borrado rápido activo, el color buffer (tanto este como el que se pasó al
+            // constructor) solo está al día después de llamar a resolve_clear():
+
+            const Color_Buffer & get_color_buffer () const
+            {
+                return (color_buffer);
+            }
+
+            void resolve_clear ();
+
+            // Activa el borrado rápido por tiles (ver resolve_clear()). Está desactivado por defecto
+            // para que el color buffer se pueda leer en cualquier momento:
+
+            void enable_fast_clear (bool enabled)
+            {
+                fast_clear = enabled;
+
+                if (!enabled) resolve_clear ();
+            }
+
+            bool is_fast_clear_enabled () const
+            {
+                return fast_clear;
+            }
+
+        public:
+
+            void set_color (const Color & new_color)
+            {
+                color = new_color;
+            }
+
+            void set_fill_engine (Fill_Engine new_fill_engine)
+            {
+                fill_engine = new_fill_engine;
+            }
+
+            Fill_Engine get_fill_engine () const
+            {
+                return fill_engine;
+            }
+
+            // El blending no se admite en el modo visibility buffer, donde no hay colores que combinar:
+
+            void set_blend_mode (Blend_Mode new_blend_mode)
+            {
+                blend_mode = new_blend_mode;
+            }
+
+            Blend_Mode get_blend_mode () const
+            {
+                return blend_mode;
+            }
+
+            // Si se desactiva, los polígonos con z-buffer hacen el test de profundidad pero no
+            // actualizan el z-buffer (lo habitual con los polígonos semitransparentes):
+
+            void enable_depth_write (bool enabled)
+            {
+                depth_write = enabled;
+            }
+
+            bool is_depth_write_enabled () const
+            {
+                return depth_write;
+            }
+
+            // Si está activo, draw_indexed() descarta los triángulos que no están en sentido
+            // antihorario en pantalla:
+
+            void enable_backface_culling (bool enabled)
+            {
+                backface_culling = enabled;
+            }
+
+            // El z-buffer jerárquico no cambia el resultado, solo evita trabajo:
+
+            void enable_hierarchical_z (bool enabled)
+            {
+                hierarchical_z = enabled;
+            }
+
+            void set_color (float r, float g, float b)
+            {
+                color_buffer.set (r, g, b);
+            }
+
+            // En el modo visibility buffer los polígonos escriben en cada píxel que cubren su ID de
+            // triángulo y de instancia en lugar de un color. Al activarlo se reserva el buffer:
+
+            void enable_visibility_buffer (bool enabled)
+            {
+                assert(bins == nullptr && !(enabled && msaa));
+
+                visibility_mode = enabled;
+
+                if (enabled && visibility_buffer.empty ())
+                {
+                    visibility_buffer.assign (z_buffer.size (), { no_triangle, 0 });
+                }
+            }
+
+            bool is_visibility_buffer_enabled () const
+            {
+                return visibility_mode;
+            }
+
+            // ID de triángulo con el que se marcan los polígonos de fill_convex_polygon*(). En
+            // draw_indexed() cada triángulo usa su posición en el index buffer:
+
+            void set_triangle_id (uint32_t new_triangle_id)
+            {
+                triangle_id = new_triangle_id;
+            }
+
+            void set_instance_id (uint32_t new_instance_id)
+            {
+                instance_id = new_instance_id;
+            }
+
+            // Completa los borrados pendientes y da acceso a las muestras, fila a fila con el mismo
+            // pitch que el color buffer:
+
+            const std::vector< Visibility_Sample > & get_visibility_buffer ()
+            {
+                resolve_clear ();
+
+                return visibility_buffer;
+            }
+
+            /** Sombrea cada píxel cubierto del visibility buffer y escribe el resultado en el color
+              * buffer. shader se llama una vez por píxel como shader (sample, x, y) y devuelve un
+              * Color. Si se pasa un thread pool, las filas se reparten en franjas de tile_size
+              * entre los workers, por lo que shader debe admitir llamadas concurrentes.
+              */
+            template< class SHADER >
+            void resolve_visibility (SHADER && shader, Thread_Pool * pool = nullptr);
+
+            // Con el MSAA activo los polígonos se rellenan en las muestras y los píxeles de los
+            // bordes del color buffer solo tienen su color final al llamar a resolve_msaa(). El
+            // z-buffer jerárquico no se usa en este modo. Al activarlo se reservan las muestras;
+            // hay que llamar a clear() antes de dibujar:
+
+            void enable_msaa (bool enabled)
+            {
+                assert(bins == nullptr && !(enabled && visibility_mode));
+
+                msaa = enabled;
+
+                if (enabled && msaa_blocks.empty ())
+                {
+                    msaa_depths.assign (z_buffer.size () * msaa_samples, Depth_Format::far_value ());
+                    msaa_blocks.assign (z_buffer.size (), no_msaa_block);
+                    msaa_pools .resize (size_t(tile_columns * tile_rows));
+                }
+            }
+
+            bool is_msaa_enabled () const
+            {
+                return msaa;
+            }
+
+            // Si está activo, los polígonos solo hacen el test de profundidad (útil con las consultas
+            // de oclusión):
+
+            void set_depth_test_only (bool enabled)
+            {
+                depth_test_only = enabled;
+            }
+
+            bool is_depth_test_only () const
+            {
+                return depth_test_only;
+            }
+
+            // Las consultas solo se admiten en el modo inmediato (no durante el binning), ya que los
+            // workers no pueden compartir el contador:
+
+            void begin_query ()
+            {
+                assert(bins == nullptr && !query_active);
+
+                query_active    = true;
+                query_fragments = 0;
+            }
+
+            // Termina la consulta y devuelve el número de fragmentos que han pasado el test desde
+            // begin_query():
+
+            uint64_t end_query ()
+            {
+                assert(query_active);
+
+                query_active = false;
+
+                return query_fragments;
+            }
+
+            /** Atributos por vértice (coordenadas de textura, colores, normales...) que se interpolan
+              * con corrección de perspectiva en los polígonos que se dibujan a continuación. values
+              * tiene count valores por vértice e inverse_w el 1 / w de cada vértice (la w de sus
+              * coordenadas de clip), ambos en el mismo orden que los vértices que se pasan a
+              * fill_convex_polygon*() y draw_indexed() (con un MeshData, los de transformed_vertices,
+              * ya que los que crea el recorte se añaden solos). Solo se leen durante esas llamadas. Los
+              * polígonos con más de tres vértices deben tener atributos coplanarios, como los que
+              * genera Clipper al recortar un triángulo. Con values nulo se vuelve al color plano.
+              */
+            void set_vertex_attributes (const float * values, const float * inverse_w, unsigned count)
+            {
+                assert(values == nullptr || (inverse_w != nullptr && count <= max_attributes));
+
+                attribute_values    = values;
+                attribute_inverse_w = values ? inverse_w : nullptr;
+                attribute_count     = values ? count     : 0;
+            }
+
+            /** Etapa de sombreado de los polígonos con atributos. El color de cada píxel es la muestra
+              * de texture en las coordenadas (u, v) de los atributos uv_attribute y uv_attribute + 1
+              * (o el color de set_color() si no hay textura), con repetición en ambos ejes y con el
+              * filtro de la textura. Si tiene mipmaps, el nivel se elige en cada quad de 2x2 píxeles
+              * a partir de las derivadas de (u, v) en pantalla. La textura debe seguir existiendo
+              * hasta que se rellenen los polígonos.
+              */
+            void set_texture (const Texture * texture, unsigned uv_attribute = 0)
+            {
+                shading.texture      = texture;
+                shading.uv_attribute = int(uv_attribute);
+            }
+
+            // El color se modula con el (r, g, b) normalizado de los atributos first_attribute a
+            // first_attribute + 2. Con un índice negativo no se modula:
+
+            void set_color_attribute (int first_attribute)
+            {
+                shading.color_attribute = first_attribute;
+            }
+
+            // El color se modula con una luz direccional difusa según la normal interpolada de los
+            // atributos normal_attribute a normal_attribute + 2, expresada en el mismo espacio que
+            // light_direction (la dirección hacia la luz). Con un índice negativo no se ilumina:
+
+            void set_lighting (int normal_attribute, const Vector3f & light_direction, float ambient = 0.2f)
+            {
+                float length = glm::length (light_direction);
+
+                shading.normal_attribute = normal_attribute;
+                shading.light_direction  = length > 0.f ? light_direction / length : Vector3f(0.f, 0.f, 1.f);
+                shading.ambient          = ambient;
+            }
+
+            /** Escribe en el color buffer la media de las muestras de cada píxel expandido (los
+              * comprimidos ya tienen su color). Si se pasa un thread pool, las filas se reparten en
+              * franjas de tile_size entre los workers.
+              */
+            void resolve_msaa (Thread_Pool * pool = nullptr);
+
+            void clear ()
+            {
+                clear ({ 0, 0, 0 });
+            }
+
+            // Durante el binning o la grabación el borrado se guarda en los bins y se aplica antes
+            // de rellenarlos. Los polígonos grabados hasta entonces quedarían tapados, así que se
+            // descartan:
+
+            void clear (const Color & new_clear_color)
+            {
+                if (bins)
+                {
+                    bins->reset (bins->tiles.size ());
+
+                    bins->clear_requested = true;
+                    bins->clear_color     = new_clear_color;
+                }
+                else
+                    start_clear (new_clear_color);
+            }
+
+            void fill_convex_polygon
+            (
+                const Point4i * const vertices, 
+                const int     * const indices_begin, 
+                const int     * const indices_end
+            );
+
+            void fill_convex_polygon_z_buffer
+            (
+                const Point4i * const vertices, 
+                const int     * const indices_begin, 
+                const int     * const indices_end
+            );
+
+            /** Dibuja de una vez todos los triángulos de indices (tres índices por triángulo) de
+              * mesh.transformed_vertices. Primero los recorta con Clipper, que proyecta los vértices
+              * en mesh.display_vertices (salvo con project_vertices = false, si ya se proyectaron
+              * con Vertex_Transformer) y añade a continuación los que crea. Los atributos de
+              * set_vertex_attributes() corresponden a mesh.transformed_vertices y los de los
+              * vértices nuevos se interpolan. Los triángulos conservan como ID su posición en indices.
+              * Con un z-buffer float la profundidad sale de las coordenadas de clip (ver from_clip()
+              * en Depth_Formats.hpp) y no de la z entera de los vértices de pantalla.
+              */
+            void draw_indexed (MeshData & mesh, const Index_Buffer & indices, bool project_vertices = true);
+
+            // Igual, pero con vértices de pantalla que no se recortan, por lo que deben estar ya
+            // dentro de la banda de guarda de Clipper y delante del plano cercano. El culling, el
+            // descarte de los triángulos que caen fuera del color buffer y la preparación se hacen
+            // en bucles sobre todo el lote antes de empezar a rellenar:
+
+            void draw_indexed (const std::vector< Point4i > & vertices, const Index_Buffer & indices);
+
+        public:
+
+            // A partir de esta llamada los polígonos no se rellenan inmediatamente, sino que se
+            // agrupan por tiles hasta que se llama a end_binning():
+
+            void begin_binning (Thread_Pool & pool);
+
+            // Rellena en paralelo todos los tiles que recibieron polígonos desde begin_binning()
+            // y vuelve al modo inmediato. Dentro de cada tile se respeta el orden de envío:
+
+            void end_binning ();
+
+            /** A partir de esta llamada los polígonos (y los clear()) se graban en bins, que se
+              * vacían antes. No se rellena nada hasta que se pasan a render_bins(). Mientras haya
+              * bins grabados pendientes de rellenar no se debe cambiar la configuración del
+              * rasterizer (motor de relleno, MSAA, visibility buffer, z-buffer jerárquico).
+              */
+            void begin_recording (Frame_Bins & target);
+
+            void end_recording ();
+
+            /** Rellena en paralelo los tiles de bins y los vacía. Se puede llamar desde un hilo
+              * distinto al que graba, siempre que bins no sean los que se están grabando: el
+              * relleno solo toca los buffers y la grabación solo toca los bins.
+              */
+            void render_bins (Frame_Bins & bins, Thread_Pool & pool);
+
+            bool is_binning () const
             {
+                return bins != nullptr;
             }
 
-            const Color_Buffer & get_color_buffer () const
+        private:
+
+            // Dibuja count triángulos de indices. triangle_ids tiene el ID de cada uno o es nulo si
+            // el ID es su posición en indices. depths es como el de Fill_Value:
+
+            void draw_triangles (const Point4i * vertices, const Depth_Interpolant * depths, const int * indices, size_t count, const uint32_t * triangle_ids);
+
+            void draw_polygon
+            (
+                const Point4i * const vertices, 
+                const int     * const indices_begin, 
+                const int     * const indices_end,
+                Polygon_Kernel        kernel
+            );
+
+            // Elige el kernel de relleno según el estado actual (z-buffer, escritura de profundidad,
+            // consulta sin escrituras, modo de blending, nivel de la CPU y motor de relleno):
+
+            Polygon_Kernel select_kernel (bool use_z_buffer) const;
+
+            template< bool DEPTH_TEST, bool DEPTH_WRITE >
+            Polygon_Kernel select_shading_kernel () const;
+
+            template< bool DEPTH_TEST, bool DEPTH_WRITE, bool SHADED >
+            Polygon_Kernel select_blend_kernel () const;
+
+            template< class POLICY >
+            Polygon_Kernel select_tier_kernel () const;
+
+            template< class POLICY >
+            Polygon_Kernel select_engine_kernel () const;
+
+            void bin_polygon
+            (
+                const Point4i * const vertices, 
+                const int     * const indices_begin, 
+                const int     * const indices_end,
+                const Fill_Value    & fill,
+                Polygon_Kernel        kernel
+            );
+
+            void fill_tile (const Frame_Bins & bins, unsigned tile_index, Edge_Cache & cache);
+
+            template< class POLICY >
+            void fill_convex_polygon_clipped
+            (
+                const Point4i        * const vertices, 
+                const int            * const indices_begin, 
+                const int            * const indices_end,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip,
+                Edge_Cache           &       cache
+            );
+
+            template< class POLICY >
+            void fill_convex_polygon_half_space
+            (
+                const Point4i        * const vertices, 
+                const int            * const indices_begin, 
+                const int            * const indices_end,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip,
+                Edge_Cache           &       cache
+            );
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                // Entrada de los kernels AVX2. Con GCC y Clang se compila para AVX2 con todo el
+                // código al que llama integrado, aunque el resto del programa no use AVX2:
+
+                template< class POLICY, bool HALF_SPACE >
+                ARGB_AVX2_KERNEL void fill_convex_polygon_avx2
+                (
+                    const Point4i        * const vertices,
+                    const int            * const indices_begin,
+                    const int            * const indices_end,
+                    const Fill_Value     &       fill,
+                    const Clip_Rectangle &       clip,
+                    Edge_Cache           &       cache
+                )
+                {
+                    if constexpr (HALF_SPACE)
+                        fill_convex_polygon_half_space< POLICY > (vertices, indices_begin, indices_end, fill, clip, cache);
+                    else
+                        fill_convex_polygon_clipped   < POLICY > (vertices, indices_begin, indices_end, fill, clip, cache);
+                }
+
+            #endif
+
+            template< class POLICY >
+            void fill_triangle_msaa
+            (
+                const Point4i        * const vertices,
+                int                          i0,
+                int                          i1,
+                int                          i2,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip
+            );
+
+            template< class POLICY, class INT32X8, class FLOAT32X8 >
+            void fill_triangle_half_space
+            (
+                const Point4i        * const vertices,
+                int                          i0,
+                int                          i1,
+                int                          i2,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip,
+                Edge_Cache           &       cache
+            );
+
+            bool is_polygon_visible
+            (
+                const Point4i        * const vertices, 
+                const int            * const indices_begin, 
+                const int            * const indices_end,
+                const Fill_Value     &       fill,
+                const Clip_Rectangle &       clip
+            );
+
+            bool is_area_visible (int min_x, int min_y, int max_x, int max_y, Depth_Interpolant z_nearest);
+
+            void refresh_z_tile (int tile_index);
+
+            void materialize_clear (int tile_index);
+
+            // Escribe el color en las muestras de mask del píxel (x, y), que está en offset,
+            // expandiéndolo si hace falta:
+
+            template< class POLICY >
+            void write_msaa_samples (int x, int y, int offset, unsigned mask, const Fill_Value & fill)
+            {
+                if (query_active) query_fragments += simd::count_bits (mask);
+
+                if constexpr (!POLICY::color_write) return;
+
+                // Los polígonos sombreados calculan un único color por píxel para todas sus muestras:
+
+                Color color = fill.color;
+
+                if constexpr (POLICY::shaded) shade_block< typename POLICY::Float32x8 > (offset, 1u, fill, &color);
+
+                Color    & pixel = color_buffer.colors ()[offset];
+                uint32_t & block = msaa_blocks[offset];
+
+                // Un píxel comprimido cubierto por completo sigue comprimido (al combinar, sus cuatro
+                // muestras darían el mismo resultado):
+
+                if (mask == 0xF && !(block & msaa_expanded_bit))
+                {
+                    POLICY::blend (pixel, color);
+                    return;
+                }
+
+                if (mask == 0xF && !POLICY::blending)
+                {
+                    pixel  = color;
+                    block &= ~msaa_expanded_bit;
+                    return;
+                }
+
+                Color * samples = (block & msaa_expanded_bit) ? msaa_samples_of (x, y, block) : expand_msaa_pixel (x, y, offset);
+
+                for ( ; mask; mask &= mask - 1)
+                {
+                    POLICY::blend (samples[simd::count_trailing_zeros (mask)], color);
+                }
+            }
+
+            Color * msaa_samples_of (int x, int y, uint32_t block)
+            {
+                return msaa_pools[(y / tile_size) * tile_columns + x / tile_size].data () + size_t(block & ~msaa_expanded_bit) * msaa_samples;
+            }
+
+            // Copia el color del píxel comprimido (x, y) en las cuatro muestras de su bloque, que se
+            // reserva en el pool de su tile si aún no lo tiene:
+
+            Color * expand_msaa_pixel (int x, int y, int offset)
+            {
+                uint32_t & block = msaa_blocks[offset];
+
+                if (block == no_msaa_block)
+                {
+                    std::vector< Color > & pool = msaa_pools[(y / tile_size) * tile_columns + x / tile_size];
+
+                    block = uint32_t(pool.size () / msaa_samples);
+
+                    pool.resize (pool.size () + msaa_samples);
+                }
+
+                block |= msaa_expanded_bit;
+
+                Color * samples = msaa_samples_of (x, y, block);
+
+                std::fill_n (samples, msaa_samples, color_buffer.colors ()[offset]);
+
+                return samples;
+            }
+
+            // Media de las cuatro muestras de count píxeles. Los formatos con componentes de 8 bits
+            // se promedian byte a byte con SIMD; el resto, componente a componente:
+
+            static void average_samples (Color * target, const Color * s0, const Color * s1, const Color * s2, const Color * s3, int count);
+
+            template< unsigned COMPONENT >
+            static typename Color::Composite_Type average_packed (const Color & s0, const Color & s1, const Color & s2, const Color & s3);
+
+            Fill_Value current_fill () const
+            {
+                return { color, { triangle_id, instance_id }, nullptr, nullptr };
+            }
+
+            // Profundidad en el formato del z-buffer del vértice index de un polígono:
+
+            static Depth_Interpolant vertex_depth (const Point4i * vertices, int index, const Fill_Value & fill)
+            {
+                return fill.depths ? fill.depths[index] : Depth_Format::from_vertex (vertices[index][2]);
+            }
+
+            bool is_shading_active () const
+            {
+                return attribute_values != nullptr && !visibility_mode;
+            }
+
+            void setup_attributes
+            (
+                const Point4i   * const vertices,
+                const int       * const indices_begin,
+                const int       * const indices_end,
+                Attribute_Setup &       setup
+            )
+            const;
+
+            /** Sombrea los píxeles offset + k cuyo bit k está activo en lanes (k < 8, todos en la
+              * misma fila) y deja su color en colors[k]. Los planos de los atributos y el nivel de
+              * mipmap de cada quad se evalúan con SIMD en los 8 carriles a la vez y cada carril se
+              * sombrea después por separado.
+              */
+            template< class FLOAT32X8 >
+            void shade_block (int offset, unsigned lanes, const Fill_Value & fill, Color * colors) const;
+
+            static Color shade_fragment (const Shading & shading, const Color & base, const float (* attributes)[8], unsigned lane, unsigned level);
+
+            static void  modulate       (Color & color, float red, float green, float blue);
+
+            // Escribe en el color buffer los píxeles sombreados offset + k cuyo bit k está activo en
+            // lanes (k < 8):
+
+            template< class POLICY >
+            void write_shaded_block (int offset, unsigned lanes, const Fill_Value & fill)
+            {
+                Color   shaded[8];
+                Color * colors = color_buffer.colors () + offset;
+
+                shade_block< typename POLICY::Float32x8 > (offset, lanes, fill, shaded);
+
+                for ( ; lanes; lanes &= lanes - 1)
+                {
+                    unsigned lane = simd::count_trailing_zeros (lanes);
+
+                    POLICY::blend (colors[lane], shaded[lane]);
+                }
+            }
+
+            // Escrituras de los algoritmos de relleno, que solo reciben los fragmentos que han pasado
+            // el test de profundidad. Van al color buffer o al visibility buffer según el modo y se
+            // cuentan si hay una consulta de oclusión abierta:
+
+            template< class POLICY >
+            void write_span (int offset, int count, const Fill_Value & fill)
+            {
+                if (query_active) query_fragments += uint64_t(count);
+
+                if constexpr (!POLICY::color_write) return;
+
+                if (visibility_mode)
+                    std::fill_n (visibility_buffer.data () + offset, count, fill.sample);
+                else
+                if constexpr (POLICY::shaded)
+                {
+                    for ( ; count >= 8; offset += 8, count -= 8) write_shaded_block< POLICY > (offset, 0xFFu, fill);
+
+                    if (count > 0) write_shaded_block< POLICY > (offset, (1u << count) - 1, fill);
+                }
+                else
+                if constexpr (POLICY::blending)
+                {
+                    Color * colors = color_buffer.colors () + offset;
+
+                    for (int index = 0; index < count; ++index) POLICY::blend (colors[index], fill.color);
+                }
+                else
+                    color_buffer.fill_span (unsigned(offset), unsigned(count), fill.color);
+            }
+
+            template< class POLICY >
+            void write_span_masked (int offset, uint32_t mask, const Fill_Value & fill)
+            {
+                if (query_active) query_fragments += simd::count_bits (mask);
+
+                if constexpr (!POLICY::color_write) return;
+
+                if (visibility_mode)
+                {
+                    for ( ; mask; mask &= mask - 1)
+                    {
+                        visibility_buffer[offset + simd::count_trailing_zeros (mask)] = fill.sample;
+                    }
+                }
+                else
+                if constexpr (POLICY::shaded)
+                {
+                    for ( ; mask; mask >>= 8, offset += 8)
+                    {
+                        if (mask & 0xFF) write_shaded_block< POLICY > (offset, mask & 0xFF, fill);
+                    }
+                }
+                else
+                if constexpr (POLICY::blending)
+                {
+                    Color * colors = color_buffer.colors () + offset;
+
+                    for ( ; mask; mask &= mask - 1)
+                    {
+                        POLICY::blend (colors[simd::count_trailing_zeros (mask)], fill.color);
+                    }
+                }
+                else
+                    color_buffer.fill_span_masked (unsigned(offset), mask, fill.color);
+            }
+
+            // Marca todos los tiles como borrados con new_clear_color. Con el borrado rápido activo
+            // cada tile se borra de verdad la primera vez que se escribe en él (o en resolve_clear()):
+
+            void start_clear (const Color & new_clear_color)
+            {
+                clear_color   = new_clear_color;
+                clear_pending = true;
+
+                std::fill (z_tile_cleared .begin (), z_tile_cleared .end (), uint8_t(1));
+                std::fill (z_tile_farthest.begin (), z_tile_farthest.end (), Depth_Format::far_value ());
+                std::fill (z_tile_dirty   .begin (), z_tile_dirty   .end (), uint8_t(0));
+
+                // Todos los píxeles quedan marcados como borrados y materialize_clear() les quita
+                // su bloque antes de escribir en ellos, así que los pools se pueden vaciar ya:
+
+                for (auto & pool : msaa_pools) pool.clear ();
+
+                if (!fast_clear) resolve_clear ();
+            }
+
+            // Borra los tiles marcados que toca el intervalo [x_begin, x_end) de la fila y:
+
+            void materialize_clear (int y, int x_begin, int x_end)
+            {
+                uint8_t * cleared = z_tile_cleared.data () + (y / z_tile_size) * z_tile_columns;
+
+                for (int tile = x_begin / z_tile_size, last = (x_end - 1) / z_tile_size; tile <= last; ++tile)
+                {
+                    if (cleared[tile]) materialize_clear ((y / z_tile_size) * z_tile_columns + tile);
+                }
+            }
+
+            Clip_Rectangle get_full_clip () const
+            {
+                return { 0, 0, int(color_buffer.get_width ()), int(color_buffer.get_height ()) };
+            }
+
+            template< typename VALUE_TYPE, size_t SHIFT >
+            void interpolate (int * cache, int v0, int v1, int y_min, int y_max, int clip_top, int clip_bottom);
+
+            void interpolate (float * cache, float v0, float v1, int y_min, int y_max, int clip_top, int clip_bottom);
+
+            void interpolate_depth (Depth_Interpolant * cache, Depth_Interpolant v0, Depth_Interpolant v1, int y_min, int y_max, int clip_top, int clip_bottom)
+            {
+                if constexpr (std::is_floating_point< Depth_Interpolant >::value)
+                    interpolate (cache, v0, v1, y_min, y_max, clip_top, clip_bottom);
+                else
+                    interpolate< int32_t, 0 > (cache, v0, v1, y_min, y_max, clip_top, clip_bottom);
+            }
+
+            // Interpolación de la profundidad a lo largo de una scanline. Con los formatos float se
+            // avanza en double para que el error no se acumule en las scanlines largas:
+
+            typedef typename std::conditional< std::is_floating_point< Depth_Interpolant >::value, double, int32_t >::type Span_Depth;
+
+            static Span_Depth span_depth_step (Depth_Interpolant z_left, Depth_Interpolant z_right, int length)
+            {
+                return (Span_Depth(z_right) - Span_Depth(z_left)) / length;
+            }
+
+            static Span_Depth span_depth_at (Depth_Interpolant z_left, Span_Depth step, int distance)
+            {
+                if constexpr (std::is_floating_point< Span_Depth >::value)
+                    return z_left + step * distance;
+                else
+                    return Span_Depth(z_left + int64_t(step) * distance);
+            }
+
+        };
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_convex_polygon
+        (
+            const Point4i * const vertices, 
+            const int     * const indices_begin, 
+            const int     * const indices_end
+        )
+        {
+            draw_polygon (vertices, indices_begin, indices_end, select_kernel (false));
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_convex_polygon_z_buffer
+        (
+            const Point4i * const vertices, 
+            const int     * const indices_begin, 
+            const int     * const indices_end
+        )
+        {
+            draw_polygon (vertices, indices_begin, indices_end, select_kernel (true));
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::draw_polygon
+        (
+            const Point4i * const vertices, 
+            const int     * const indices_begin, 
+            const int     * const indices_end,
+            Polygon_Kernel        kernel
+        )
+        {
+            Fill_Value      fill = current_fill ();
+            Attribute_Setup setup;
+
+            if (is_shading_active ())
+            {
+                setup_attributes (vertices, indices_begin, indices_end, setup);
+
+                fill.setup = &setup;
+            }
+
+            if (bins)
+            {
+                bin_polygon (vertices, indices_begin, indices_end, fill, kernel);
+            }
+            else
+            {
+                (this->*kernel) (vertices, indices_begin, indices_end, fill, get_full_clip (), edge_cache);
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Polygon_Kernel Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::select_kernel (bool use_z_buffer) const
+        {
+            assert(!(visibility_mode && blend_mode != Blend_Mode::REPLACE));
+
+            if (!use_z_buffer  ) return select_shading_kernel< false, false > ();
+            if (depth_test_only) return select_tier_kernel< Fill_Policy< true, false, false > > ();
+            if (depth_write    ) return select_shading_kernel< true,  true  > ();
+
+            return select_shading_kernel< true, false > ();
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< bool DEPTH_TEST, bool DEPTH_WRITE >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Polygon_Kernel Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::select_shading_kernel () const
+        {
+            // En el modo visibility buffer no se escriben colores, así que no hace falta sombrear:
+
+            if (is_shading_active ())
+            {
+                assert(shading.texture          == nullptr || shading.uv_attribute     + 2 <= int(attribute_count));
+                assert(shading.color_attribute  <  0       || shading.color_attribute  + 3 <= int(attribute_count));
+                assert(shading.normal_attribute <  0       || shading.normal_attribute + 3 <= int(attribute_count));
+
+                return select_blend_kernel< DEPTH_TEST, DEPTH_WRITE, true  > ();
+            }
+            else
+                return select_blend_kernel< DEPTH_TEST, DEPTH_WRITE, false > ();
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< bool DEPTH_TEST, bool DEPTH_WRITE, bool SHADED >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Polygon_Kernel Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::select_blend_kernel () const
+        {
+            switch (blend_mode)
+            {
+                case Blend_Mode::HALF:
+                    return select_tier_kernel< Fill_Policy< DEPTH_TEST, DEPTH_WRITE, true, Blend< argb::blend_half< Color > >, SHADED > > ();
+
+                default:
+                    return select_tier_kernel< Fill_Policy< DEPTH_TEST, DEPTH_WRITE, true, void, SHADED > > ();
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Polygon_Kernel Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::select_tier_kernel () const
+        {
+            // Las variantes que no se han compilado quedan a nullptr y se usa la del nivel inferior.
+            // AVX-512 usa la de AVX2, ya que los kernels trabajan con vectores de 8 carriles:
+
+            Polygon_Kernel sse2 = nullptr;
+            Polygon_Kernel avx2 = nullptr;
+
+            #if defined(SIMD_SSE2_AVAILABLE)
+                sse2 = select_engine_kernel< Tiered_Policy< POLICY, simd::Sse2_Tier > > ();
+            #endif
+
+            #if defined(SIMD_AVX2_DISPATCH)
+                if (fill_engine == Fill_Engine::HALF_SPACE)
+                    avx2 = &Rasterizer::fill_convex_polygon_avx2< Tiered_Policy< POLICY, simd::Avx2_Tier >, true  >;
+                else
+                    avx2 = &Rasterizer::fill_convex_polygon_avx2< Tiered_Policy< POLICY, simd::Avx2_Tier >, false >;
+            #endif
+
+            return argb::select_by_cpu_tier (select_engine_kernel< Tiered_Policy< POLICY, simd::Scalar_Tier > > (), sse2, avx2);
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Polygon_Kernel Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::select_engine_kernel () const
+        {
+            if (fill_engine == Fill_Engine::HALF_SPACE)
+                return &Rasterizer::fill_convex_polygon_half_space< POLICY >;
+            else
+                return &Rasterizer::fill_convex_polygon_clipped< POLICY >;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::draw_indexed (MeshData & mesh, const Index_Buffer & indices, bool project_vertices)
+        {
+            clipper.clip (mesh.transformed_vertices, indices, mesh.display_vertices, clipped_indices, project_vertices);
+
+            const uint32_t          * triangle_ids = clipper.get_source_triangles ().data ();
+            const size_t              count        = clipped_indices.size () / 3;
+            const Depth_Interpolant * depths       = nullptr;
+
+            // Con un z-buffer float la profundidad se interpola a partir de z / w en lugar de la z
+            // entera de display_vertices. Los vértices con w <= 0 no los usa ningún triángulo visible:
+
+            if constexpr (std::is_floating_point< Depth_Interpolant >::value)
+            {
+                clipped_depths.resize (clipper.get_vertex_count ());
+
+                for (size_t index = 0; index < clipped_depths.size (); ++index)
+                {
+                    const Point4f & position = clipper.get_position (index);
+
+                    clipped_depths[index] = position.w > 0.f ? Depth_Format::from_clip (position.z, position.w) : Depth_Format::far_value ();
+                }
+
+                depths = clipped_depths.data ();
+            }
+
+            if (attribute_values == nullptr || clipper.get_clipped_vertices ().empty ())
+            {
+                draw_triangles (mesh.display_vertices.data (), depths, clipped_indices.data (), count, triangle_ids);
+                return;
+            }
+
+            // Los arrays del llamante solo tienen los vértices originales. Durante el dibujo se
+            // sustituyen por copias ampliadas con los vértices creados al recortar:
+
+            const float  * values       = attribute_values;
+            const float  * inverse_w    = attribute_inverse_w;
+            const size_t   vertex_count = mesh.transformed_vertices.size ();
+
+            clipped_attributes.assign (values, values + vertex_count * attribute_count);
+            clipper.interpolate_attributes (clipped_attributes, attribute_count);
+
+            clipper.get_inverse_w (clipped_inverse_w);
+            std::copy (inverse_w, inverse_w + vertex_count, clipped_inverse_w.begin ());
+
+            attribute_values    = clipped_attributes.data ();
+            attribute_inverse_w = clipped_inverse_w .data ();
+
+            draw_triangles (mesh.display_vertices.data (), depths, clipped_indices.data (), count, triangle_ids);
+
+            attribute_values    = values;
+            attribute_inverse_w = inverse_w;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::draw_indexed (const std::vector< Point4i > & vertices, const Index_Buffer & indices)
+        {
+            draw_triangles (vertices.data (), nullptr, indices.data (), indices.size () / 3, nullptr);
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::draw_triangles (const Point4i * vertex_data, const Depth_Interpolant * depths, const int * indices, size_t count, const uint32_t * triangle_ids)
+        {
+            const int     * index_iterator  = indices;
+            const int     * indices_end     = indices + count * 3;
+            const int       width           = int(color_buffer.get_width  ());
+            const int       height          = int(color_buffer.get_height ());
+
+            // Primera pasada: culling de caras traseras, de triángulos degenerados y de los que
+            // quedan completamente fuera del color buffer. Solo se leen los vértices una vez y los
+            // supervivientes se guardan ya orientados en sentido antihorario:
+
+            triangle_setups.clear ();
+            triangle_setups.reserve (count);
+
+            for (uint32_t triangle_index = 0; index_iterator < indices_end; index_iterator += 3, ++triangle_index)
+            {
+                int i0 = index_iterator[0];
+                int i1 = index_iterator[1];
+                int i2 = index_iterator[2];
+
+                const Point4i & v0 = vertex_data[i0];
+                const Point4i & v1 = vertex_data[i1];
+                const Point4i & v2 = vertex_data[i2];
+
+                int64_t area = int64_t(v1[0] - v0[0]) * (v2[1] - v0[1]) - int64_t(v2[0] - v0[0]) * (v1[1] - v0[1]);
+
+                if (area == 0) continue;
+
+                if (area < 0)
+                {
+                    if (backface_culling) continue;
+
+                    std::swap (i1, i2);
+                }
+
+                if (std::max ({ v0[0], v1[0], v2[0] }) <= 0 || std::min ({ v0[0], v1[0], v2[0] }) >= width ) continue;
+                if (std::max ({ v0[1], v1[1], v2[1] }) <= 0 || std::min ({ v0[1], v1[1], v2[1] }) >= height) continue;
+
+                triangle_setups.push_back ({ { i0, i1, i2 }, triangle_ids ? triangle_ids[triangle_index] : triangle_index });
+            }
+
+            // Segunda pasada: relleno (o reparto entre tiles en el modo binned) con el kernel que
+            // corresponde al estado actual:
+
+            Fill_Value      fill    = current_fill ();
+            Polygon_Kernel  kernel  = select_kernel (true);
+            const bool      shaded  = is_shading_active ();
+            Attribute_Setup setup;
+
+            fill.depths = depths;
+
+            if (shaded) fill.setup = &setup;
+
+            if (bins)
+            {
+                for (const auto & triangle : triangle_setups)
+                {
+                    fill.sample.triangle_id = triangle.triangle_id;
+
+                    if (shaded) setup_attributes (vertex_data, triangle.indices, triangle.indices + 3, setup);
+
+                    bin_polygon (vertex_data, triangle.indices, triangle.indices + 3, fill, kernel);
+                }
+            }
+            else
+            {
+                const Clip_Rectangle clip = get_full_clip ();
+
+                for (const auto & triangle : triangle_setups)
+                {
+                    fill.sample.triangle_id = triangle.triangle_id;
+
+                    if (shaded) setup_attributes (vertex_data, triangle.indices, triangle.indices + 3, setup);
+
+                    (this->*kernel) (vertex_data, triangle.indices, triangle.indices + 3, fill, clip, edge_cache);
+                }
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::begin_binning (Thread_Pool & pool)
+        {
+            begin_recording (own_bins);
+
+            thread_pool = &pool;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::end_binning ()
+        {
+            assert(thread_pool != nullptr && bins == &own_bins);
+
+            end_recording ();
+
+            render_bins (own_bins, *thread_pool);
+
+            thread_pool = nullptr;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::begin_recording (Frame_Bins & target)
+        {
+            assert(bins == nullptr && !query_active);
+
+            target.reset (size_t(tile_columns * tile_rows));
+
+            bins = &target;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::end_recording ()
+        {
+            assert(bins != nullptr);
+
+            bins = nullptr;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::render_bins (Frame_Bins & frame_bins, Thread_Pool & pool)
+        {
+            assert(frame_bins.tiles.size () == size_t(tile_columns * tile_rows));
+
+            if (frame_bins.clear_requested)
+            {
+                start_clear (frame_bins.clear_color);
+            }
+
+            // Cada worker necesita sus propias cachés de lados. Solo se redimensionan la primera
+            // vez, en los siguientes frames se reutilizan:
+
+            worker_caches.resize (pool.get_worker_count ());
+
+            for (auto & cache : worker_caches)
+            {
+                if (cache.offset_cache0.size () < color_buffer.get_height () + 2)
+                {
+                    cache.resize (color_buffer.get_height ());
+                }
+            }
+
+            pool.run
+            (
+                unsigned(frame_bins.tiles.size ()),
+                [this, &frame_bins] (unsigned worker_index, unsigned tile_index)
+                {
+                    fill_tile (frame_bins, tile_index, worker_caches[worker_index]);
+                }
+            );
+
+            frame_bins.reset (frame_bins.tiles.size ());
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::bin_polygon
+        (
+            const Point4i * const vertices, 
+            const int     * const indices_begin, 
+            const int     * const indices_end,
+            const Fill_Value    & fill,
+            Polygon_Kernel        kernel
+        )
+        {
+            int vertex_count = int(indices_end - indices_begin);
+            int first_vertex = int(bins->vertices.size ());
+
+            if (vertex_count < 3) return;
+
+            // Se copian los vértices (el buffer del llamante puede cambiar antes de end_binning())
+            // y se calcula su bounding box:
+
+            int min_x = std::numeric_limits< int >::max (), max_x = std::numeric_limits< int >::min ();
+            int min_y = std::numeric_limits< int >::max (), max_y = std::numeric_limits< int >::min ();
+
+            for (const int * index = indices_begin; index < indices_end; ++index)
+            {
+                const Point4i & vertex = vertices[*index];
+
+                bins->vertices.push_back (vertex);
+
+                min_x = std::min (min_x, vertex[0]);
+                max_x = std::max (max_x, vertex[0]);
+                min_y = std::min (min_y, vertex[1]);
+                max_y = std::max (max_y, vertex[1]);
+            }
+
+            // Con MSAA las muestras de la columna anterior y de la última fila también pueden
+            // quedar dentro (ver fill_triangle_msaa()):
+
+            if (msaa)
+            {
+                min_x -= 1;
+                max_y += 1;
+            }
+
+            // Los bordes derecho e inferior no se rellenan, por lo que se descartan los polígonos
+            // degenerados y se recorta la bounding box al área del color buffer:
+
+            min_x = std::max (min_x, 0);
+            min_y = std::max (min_y, 0);
+            max_x = std::min (max_x, int(color_buffer.get_width  ()));
+            max_y = std::min (max_y, int(color_buffer.get_height ()));
+
+            if (min_x >= max_x || min_y >= max_y)
+            {
+                bins->vertices.resize (size_t(first_vertex));
+                return;
+            }
+
+            int polygon_index = int(bins->polygons.size ());
+            int setup_index   = -1;
+            int first_depth   = -1;
+
+            if (fill.setup)
+            {
+                setup_index = int(bins->setups.size ());
+
+                bins->setups.push_back (*fill.setup);
+            }
+
+            if (fill.depths)
+            {
+                first_depth = int(bins->depths.size ());
+
+                for (const int * index = indices_begin; index < indices_end; ++index)
+                {
+                    bins->depths.push_back (fill.depths[*index]);
+                }
+            }
+
+            bins->polygons.push_back ({ first_vertex, vertex_count, setup_index, first_depth, fill, kernel });
+
+            std::vector< int > & sequential_indices = bins->sequential_indices;
+
+            if (int(sequential_indices.size ()) < vertex_count)
+            {
+                for (int index = int(sequential_indices.size ()); index < vertex_count; ++index)
+                {
+                    sequential_indices.push_back (index);
+                }
+            }
+
+            int first_column = min_x / tile_size, last_column = (max_x - 1) / tile_size;
+            int first_row    = min_y / tile_size, last_row    = (max_y - 1) / tile_size;
+
+            for (int row = first_row; row <= last_row; ++row)
+            {
+                for (int column = first_column; column <= last_column; ++column)
+                {
+                    bins->tiles[row * tile_columns + column].push_back (polygon_index);
+                }
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_tile (const Frame_Bins & frame_bins, unsigned tile_index, Edge_Cache & cache)
+        {
+            const std::vector< int > & bin = frame_bins.tiles[tile_index];
+
+            if (bin.empty ()) return;
+
+            int column = int(tile_index) % tile_columns;
+            int row    = int(tile_index) / tile_columns;
+
+            Clip_Rectangle clip
+            {
+                column * tile_size,
+                row    * tile_size,
+                std::min ((column + 1) * tile_size, int(color_buffer.get_width  ())),
+                std::min ((row    + 1) * tile_size, int(color_buffer.get_height ()))
+            };
+
+            for (int polygon_index : bin)
+            {
+                const Binned_Polygon & polygon = frame_bins.polygons[polygon_index];
+                const Point4i        * vertices = frame_bins.vertices.data () + polygon.first_vertex;
+                const int            * indices  = frame_bins.sequential_indices.data ();
+
+                // La preparación de los atributos y las profundidades se copiaron en los bins junto
+                // con el polígono:
+
+                Fill_Value fill = polygon.fill;
+
+                fill.setup  = polygon.setup_index < 0 ? nullptr : frame_bins.setups.data () + polygon.setup_index;
+                fill.depths = polygon.first_depth < 0 ? nullptr : frame_bins.depths.data () + polygon.first_depth;
+
+                (this->*polygon.kernel) (vertices, indices, indices + polygon.vertex_count, fill, clip, cache);
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_convex_polygon_clipped
+        (
+            const Point4i        * const vertices, 
+            const int            * const indices_begin, 
+            const int            * const indices_end,
+            const Fill_Value     &       fill,
+            const Clip_Rectangle &       clip,
+            Edge_Cache           &       cache
+        )
+        {
+            if (msaa)
+            {
+                for (const int * index = indices_begin + 1; index + 1 < indices_end; ++index)
+                {
+                    fill_triangle_msaa< POLICY > (vertices, *indices_begin, index[0], index[1], fill, clip);
+                }
+
+                return;
+            }
+
+            // Solo se interpolan las filas que caen dentro de clip y cada scanline se recorta a su
+            // intervalo horizontal, por lo que el polígono puede salirse del color buffer.
+
+                  int                 pitch         = color_buffer.get_pitch ();
+                  int               * offset_cache0 = cache.offset_cache0.data ();
+                  int               * offset_cache1 = cache.offset_cache1.data ();
+                  Depth_Interpolant * z_cache0      = cache.z_cache0.data ();
+                  Depth_Interpolant * z_cache1      = cache.z_cache1.data ();
+                  Depth_Value       * depths        = z_buffer.data ();
+            const int               * indices_back  = indices_end - 1;
+
+            // Se busca el vértice de inicio (el que tiene menor Y) y el de terminación (el que tiene mayor Y):
+
+            const int * start_index   = indices_begin;
+                  int   start_y       = vertices[*start_index][1];
+            const int * end_index     = indices_begin;
+                  int   end_y         = start_y;
+
+            for (const int * index_iterator = start_index; ++index_iterator < indices_end; )
+            {
+                int current_y = vertices[*index_iterator][1];
+
+                if (current_y < start_y)
+                {
+                    start_y     = current_y; 
+                    start_index = index_iterator;
+                }
+                else
+                if (current_y > end_y)
+                {
+                    end_y       = current_y;
+                    end_index   = index_iterator;
+                }
+            }
+
+            if (end_y <= clip.top || start_y >= clip.bottom) return;
+
+            // Se descarta el polígono si queda oculto en todos los tiles del z-buffer jerárquico:
+
+            Depth_Interpolant z_nearest = Depth_Interpolant();
+
+            if (POLICY::depth_test && hierarchical_z)
+            {
+                if (!is_polygon_visible (vertices, indices_begin, indices_end, fill, clip)) return;
+
+                z_nearest = vertex_depth (vertices, *indices_begin, fill);
+
+                for (const int * index = indices_begin; ++index < indices_end; )
+                {
+                    z_nearest = Depth_Format::nearest (z_nearest, vertex_depth (vertices, *index, fill));
+                }
+            }
+
+            // Se cachean los lados en sentido antihorario:
+
+            const int * current_index = start_index;
+            const int *    next_index = start_index > indices_begin ? start_index - 1 : indices_back;
+
+            int               y0 = vertices[*current_index][1];
+            int               y1 = vertices[*   next_index][1];
+            Depth_Interpolant z0 = POLICY::depth_test ? vertex_depth (vertices, *current_index, fill) : Depth_Interpolant();
+            Depth_Interpolant z1 = POLICY::depth_test ? vertex_depth (vertices, *   next_index, fill) : Depth_Interpolant();
+            int               o0 = vertices[*current_index][0] + y0 * pitch;
+            int               o1 = vertices[*   next_index][0] + y1 * pitch;
+
+            while (true)
+            {
+                interpolate< int64_t, 32 > (offset_cache0, o0, o1, y0, y1, clip.top, clip.bottom);
+
+                if (POLICY::depth_test) interpolate_depth (z_cache0, z0, z1, y0, y1, clip.top, clip.bottom);
+
+                if (current_index == indices_begin) current_index = indices_back; else current_index--;
+                if (current_index == end_index    ) break;
+                if (   next_index == indices_begin) next_index    = indices_back; else    next_index--;
+
+                y0 = y1;
+                y1 = vertices[*next_index][1];
+                z0 = z1;
+                z1 = POLICY::depth_test ? vertex_depth (vertices, *next_index, fill) : Depth_Interpolant();
+                o0 = o1;
+                o1 = vertices[*next_index][0] + y1 * pitch;
+            }
+
+            int end_offset = o1;
+
+            // Se cachean los lados en sentido horario:
+
+            current_index = start_index;
+               next_index = start_index < indices_back ? start_index + 1 : indices_begin;
+
+            y0 = vertices[*current_index][1];
+            y1 = vertices[*   next_index][1];
+            z0 = POLICY::depth_test ? vertex_depth (vertices, *current_index, fill) : Depth_Interpolant();
+            z1 = POLICY::depth_test ? vertex_depth (vertices, *   next_index, fill) : Depth_Interpolant();
+            o0 = vertices[*current_index][0] + y0 * pitch;
+            o1 = vertices[*   next_index][0] + y1 * pitch;
+
+            while (true)
+            {
+                interpolate< int64_t, 32 > (offset_cache1, o0, o1, y0, y1, clip.top, clip.bottom);
+
+                if (POLICY::depth_test) interpolate_depth (z_cache1, z0, z1, y0, y1, clip.top, clip.bottom);
+
+                if (current_index == indices_back) current_index = indices_begin; else current_index++;
+                if (current_index == end_index   ) break;
+                if (   next_index == indices_back) next_index    = indices_begin; else next_index++;
+
+                y0 = y1;
+                y1 = vertices[*next_index][1];
+                z0 = z1;
+                z1 = POLICY::depth_test ? vertex_depth (vertices, *next_index, fill) : Depth_Interpolant();
+                o0 = o1;
+                o1 = vertices[*next_index][0] + y1 * pitch;
+            }
+
+            if (o1 > end_offset) end_offset = o1;
+
+            // Se rellenan las scanlines que caen dentro de clip. Cada una se recorta al intervalo
+            // [left, right) de su fila, por lo que no hace falta comprobar cada píxel:
+
+            int first_y = std::max (start_y, clip.top   );
+            int last_y  = std::min (end_y,   clip.bottom);
+
+            for (int y = first_y, row_offset = first_y * pitch; y < last_y; y++, row_offset += pitch)
+            {
+                int               left    = offset_cache0[y];
+                int               right   = offset_cache1[y];
+                Depth_Interpolant z_left  = POLICY::depth_test ? z_cache0[y] : Depth_Interpolant();
+                Depth_Interpolant z_right = POLICY::depth_test ? z_cache1[y] : Depth_Interpolant();
+
+                if (left > right)
+                {
+                    std::swap (left,   right  );
+                    std::swap (z_left, z_right);
+                }
+
+                if (left == right) continue;
+
+                int begin  = std::max (left,  row_offset + clip.left );
+                int end    = std::min (right, row_offset + clip.right);
+
+                if (clear_pending && begin < end) materialize_clear (y, begin - row_offset, end - row_offset);
+
+                if (POLICY::depth_test)
+                {
+                    Span_Depth z_step = span_depth_step (z_left, z_right, right - left);
+                    Span_Depth z      = span_depth_at   (z_left, z_step, begin - left);
+
+                    if (hierarchical_z)
+                    {
+                        // La scanline se recorre en tramos que no cruzan tiles de 8 píxeles para
+                        // saltarse los que están ocultos y marcar los que reciben escrituras:
+
+                        const Depth_Value * tile_farthest = z_tile_farthest.data () + (y / z_tile_size) * z_tile_columns;
+                        uint8_t           * tile_dirty    = z_tile_dirty   .data () + (y / z_tile_size) * z_tile_columns;
+
+                        for (int offset = begin; offset < end; )
+                        {
+                            int tile      = (offset - row_offset) / z_tile_size;
+                            int tile_end  = std::min (end, row_offset + (tile + 1) * z_tile_size);
+
+                            if (Depth_Format::hidden (z_nearest, tile_farthest[tile]))
+                            {
+                                z     += z_step * (tile_end - offset);
+                                offset = tile_end;
+                                continue;
+                            }
+
+                            int      tile_begin = offset;
+                            uint32_t written    = 0;
+
+                            for ( ; offset < tile_end; ++offset, z += z_step)
+                            {
+                                if (Depth_Format::closer (Depth_Interpolant(z), depths[offset]))
+                                {
+                                    if (POLICY::depth_write) depths[offset] = Depth_Format::to_value (Depth_Interpolant(z));
+
+                                    written |= 1u << (offset - tile_begin);
+                                }
+                            }
+
+                            if (written)
+                            {
+                                write_span_masked< POLICY > (tile_begin, written, fill);
+                                tile_dirty[tile] = 1;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        // El color se escribe por tramos de píxeles consecutivos que pasan el test.
+                        // Cada tramo se rellena al encontrar un píxel que no lo pasa:
+
+                        int run_begin = begin;
+
+                        for (int offset = begin; offset < end; ++offset, z += z_step)
+                        {
+                            if (Depth_Format::closer (Depth_Interpolant(z), depths[offset]))
+                            {
+                                if (POLICY::depth_write) depths[offset] = Depth_Format::to_value (Depth_Interpolant(z));
+                            }
+                            else
+                            {
+                                if (run_begin < offset) write_span< POLICY > (run_begin, offset - run_begin, fill);
+
+                                run_begin = offset + 1;
+                            }
+                        }
+
+                        if (run_begin < end) write_span< POLICY > (run_begin, end - run_begin, fill);
+                    }
+                }
+                else
+                if (begin < end)
+                {
+                    write_span< POLICY > (begin, end - begin, fill);
+                }
+
+                if (right > end_offset) break;
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_convex_polygon_half_space
+        (
+            const Point4i        * const vertices, 
+            const int            * const indices_begin, 
+            const int            * const indices_end,
+            const Fill_Value     &       fill,
+            const Clip_Rectangle &       clip,
+            Edge_Cache           &       cache
+        )
+        {
+            // El polígono convexo se descompone en un abanico de triángulos:
+
+            for (const int * index = indices_begin + 1; index + 1 < indices_end; ++index)
+            {
+                fill_triangle_half_space< POLICY, typename POLICY::Int32x8, typename POLICY::Float32x8 > (vertices, *indices_begin, index[0], index[1], fill, clip, cache);
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY, class INT32X8, class FLOAT32X8 >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_triangle_half_space
+        (
+            const Point4i        * const vertices,
+            int                          i0,
+            int                          i1,
+            int                          i2,
+            const Fill_Value     &       fill,
+            const Clip_Rectangle &       clip,
+            Edge_Cache           &       cache
+        )
+        {
+            if (msaa)
+            {
+                fill_triangle_msaa< POLICY > (vertices, i0, i1, i2, fill, clip);
+                return;
+            }
+
+            // Se calcula el doble del área con signo. Si es negativa se intercambian dos vértices
+            // para que el interior quede siempre en el lado positivo de las tres aristas:
+
+            const Point4i * a = vertices + i0;
+            const Point4i * b = vertices + i1;
+            const Point4i * c = vertices + i2;
+
+            int64_t area = int64_t((*b)[0] - (*a)[0]) * ((*c)[1] - (*a)[1]) - int64_t((*c)[0] - (*a)[0]) * ((*b)[1] - (*a)[1]);
+
+            if (area == 0) return;
+
+            if (area < 0)
+            {
+                std::swap (b, c);
+                std::swap (i1, i2);
+                area = -area;
+            }
+
+            // Bounding box recortada a clip. El inicio en X se alinea a 8 para que los bloques no
+            // crucen los bordes de los tiles (clip.left siempre es múltiplo de 8):
+
+            assert(clip.left % 8 == 0);
+
+            int min_x = std::max (std::min ({ (*a)[0], (*b)[0], (*c)[0] }), clip.left);
+            int min_y = std::max (std::min ({ (*a)[1], (*b)[1], (*c)[1] }), clip.top );
+            int max_x = std::min (std::max ({ (*a)[0], (*b)[0], (*c)[0] }), clip.right );
+            int max_y = std::min (std::max ({ (*a)[1], (*b)[1], (*c)[1] }), clip.bottom);
+
+            if (min_x >= max_x || min_y >= max_y) return;
+
+            min_x &= ~7;
+
+            // Profundidades de los vértices en el formato del z-buffer y la más cercana de ellas:
+
+            constexpr bool float_depth = std::is_floating_point< Depth_Interpolant >::value;
+
+            const Depth_Interpolant za = POLICY::depth_test ? vertex_depth (vertices, i0, fill) : Depth_Interpolant();
+            const Depth_Interpolant zb = POLICY::depth_test ? vertex_depth (vertices, i1, fill) : Depth_Interpolant();
+            const Depth_Interpolant zc = POLICY::depth_test ? vertex_depth (vertices, i2, fill) : Depth_Interpolant();
+
+            const Depth_Interpolant z_nearest = Depth_Format::nearest (za, Depth_Format::nearest (zb, zc));
+
+            if (POLICY::depth_test && hierarchical_z && !is_area_visible (min_x, min_y, max_x, max_y, z_nearest))
+            {
+                return;
+            }
+
+            // Funciones de arista E(x, y) = A * x + B * y + C, positivas en el interior. Las aristas
+            // que no son superiores ni izquierdas reciben un sesgo de -1 para que los píxeles que
+            // caen justo sobre un lado compartido solo los rellene uno de los dos triángulos:
+
+            const Point4i * edge_start[3] = { a, b, c };
+            const Point4i * edge_end  [3] = { b, c, a };
+
+            int32_t edge_a  [3];
+            int32_t edge_b  [3];
+            int32_t edge_row[3];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                const Point4i & p = *edge_start[i];
+                const Point4i & q = *edge_end  [i];
+
+                edge_a[i] = p[1] - q[1];
+                edge_b[i] = q[0] - p[0];
+
+                bool top_left = edge_a[i] > 0 || (edge_a[i] == 0 && edge_b[i] > 0);
+
+                edge_row[i] = int32_t
+                (
+                    int64_t(edge_a[i]) * (min_x + 1 - p[0]) + int64_t(edge_b[i]) * (min_y - p[1]) + (top_left ? 0 : -1)
+                );
+            }
+
+            // Cada carril del bloque está desplazado k píxeles respecto al primero:
+
+            int32_t lane_offsets[3][8];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int k = 0; k < 8; ++k) lane_offsets[i][k] = edge_a[i] * k;
+            }
+
+            INT32X8 edge_lanes[3] =
+            {
+                INT32X8::load (lane_offsets[0]),
+                INT32X8::load (lane_offsets[1]),
+                INT32X8::load (lane_offsets[2]),
+            };
+
+            // La profundidad es un plano z(x, y) = z0 + dz_dx * (x - x0) + dz_dy * (y - y0). Se evalúa
+            // en el mismo punto que la cobertura (x + 1, y) para que los píxeles cubiertos nunca
+            // extrapolen fuera del triángulo.
+            //
+            // Con los formatos enteros se evalúa en coma flotante al comienzo de cada fila, se lleva
+            // a cada bloque sumando en punto fijo 32.32 el paso de un bloque tantas veces como bloques
+            // lo separan del comienzo, y los carriles se desplazan con enteros respecto al primero.
+            // El comienzo de la fila se toma siempre en plane_x (el inicio de la bounding box sin
+            // recortar), de modo que el resultado no depende de clip y el modo binned coincide con
+            // el inmediato. Con los formatos float se evalúa en double al comienzo de cada bloque y
+            // los carriles se desplazan en float:
+
+            typedef typename std::conditional< float_depth, FLOAT32X8, INT32X8 >::type DEPTH32X8;
+
+            const int plane_x = std::min ({ (*a)[0], (*b)[0], (*c)[0] }) & ~7;
+
+            double    dz_dx = 0, dz_dy = 0;
+            int64_t   z_block_step = 0;
+            DEPTH32X8 z_lanes = DEPTH32X8::set1 (0);
+
+            if (POLICY::depth_test)
+            {
+                double inverse_area = 1.0 / double(area);
+                double dz1 = double(zb) - double(za), dz2 = double(zc) - double(za);
+                double dx1 = double((*b)[0] - (*a)[0]), dx2 = double((*c)[0] - (*a)[0]);
+                double dy1 = double((*b)[1] - (*a)[1]), dy2 = double((*c)[1] - (*a)[1]);
+
+                dz_dx = (dz1 * dy2 - dz2 * dy1) * inverse_area;
+                dz_dy = (dz2 * dx1 - dz1 * dx2) * inverse_area;
+
+                Depth_Interpolant z_offsets[8];
+
+                if constexpr (float_depth)
+                {
+                    for (int k = 0; k < 8; ++k) z_offsets[k] = float(dz_dx * k);
+                }
+                else
+                {
+                    // En triángulos casi de canto (muy finos y con mucha variación de profundidad) el
+                    // plano se sale del rango de 32 bits dentro de la bounding box. Esos pocos se
+                    // rellenan recorriendo las aristas, donde la profundidad nunca sale del rango de
+                    // la de sus vértices. Se mira la bounding box sin recortar para que la decisión
+                    // sea la misma en todos los tiles:
+
+                    int width  = std::max ({ (*a)[0], (*b)[0], (*c)[0] }) - plane_x + 8;
+                    int height = std::max ({ (*a)[1], (*b)[1], (*c)[1] }) - std::min ({ (*a)[1], (*b)[1], (*c)[1] });
+
+                    if (std::abs (dz_dx) * width + std::abs (dz_dy) * height > double(1 << 30))
+                    {
+                        const Point4i triangle[] = { *a, *b, *c };
+                        const int     indices [] = { 0, 1, 2 };
+
+                        fill_convex_polygon_clipped< POLICY > (triangle, indices, indices + 3, fill, clip, cache);
+
+                        return;
+                    }
+
+                    z_block_step = int64_t(dz_dx * 8.0 * 4294967296.0);
+
+                    // Redondeo de std::lround() (los empates se alejan de 0) sin llamar a la
+                    // biblioteca en cada triángulo. value - integral es exacto:
+
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        double  value    = dz_dx * k;
+                        int64_t integral = int64_t(value);
+                        double  fraction = value - double(integral);
+
+                        z_offsets[k] = int32_t(integral + (fraction >= .5 ? 1 : fraction <= -.5 ? -1 : 0));
+                    }
+                }
+
+                z_lanes = DEPTH32X8::load (z_offsets);
+            }
+
+            // Los formatos de 32 bits hacen el test de profundidad con SIMD comparando los valores
+            // como enteros. El resto lo hace carril a carril:
+
+            constexpr bool simd_depth_test = POLICY::depth_test && sizeof(Depth_Value) == sizeof(int32_t);
+
+            int           pitch  = color_buffer.get_pitch ();
+            Depth_Value * depths = z_buffer.data ();
+
+            // Parte del plano de profundidad que no cambia de una fila a otra:
+
+            const double z_plane_x = POLICY::depth_test ? dz_dx * (plane_x + 1 - (*a)[0]) : 0.0;
+
+            // Si la bounding box tiene más de dos bloques de ancho, en cada fila se calcula a partir
+            // de las aristas el intervalo de píxeles que pueden quedar dentro, de modo que no se
+            // evalúan los bloques vacíos que quedan a sus lados (en un triángulo grande, cerca de la
+            // mitad de la bounding box). En la fila, E(x) = edge_row + A * (x - min_x) no es negativa
+            // a partir de x - min_x = -edge_row / A si A > 0 y hasta ese valor si A < 0. El cociente
+            // se calcula con el inverso de A, así que el intervalo se amplía un píxel por cada lado
+            // para cubrir el error de redondeo (la máscara de cobertura sigue siendo exacta):
+
+            const bool row_spans = max_x - min_x > 16;
+            const int  row_width = max_x - min_x;
+
+            // Un triángulo pequeño que cabe en un solo bloque por fila y en un solo tile del z-buffer
+            // jerárquico ya lo ha aceptado is_area_visible(), así que no se vuelve a mirar el tile
+            // en cada fila:
+
+            const bool single_tile = max_x - min_x <= z_tile_size && min_y / z_tile_size == (max_y - 1) / z_tile_size;
+
+            double inverse_a[3] = { 0, 0, 0 };
+
+            if (row_spans)
+            {
+                for (int i = 0; i < 3; ++i) if (edge_a[i] != 0) inverse_a[i] = 1.0 / edge_a[i];
+            }
+
+            for (int y = min_y; y < max_y; ++y)
+            {
+                int x_begin = min_x;
+                int x_end   = max_x;
+
+                if (row_spans)
+                {
+                    int first = 0, last = row_width - 1;
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        const double bound = std::max (-2.0, std::min (-double(edge_row[i]) * inverse_a[i], double(row_width + 1)));
+
+                        if (edge_a[i] > 0)
+                            first = std::max (first, int(bound) - 1);
+                        else
+                        if (edge_a[i] < 0)
+                            last  = std::min (last,  int(bound) + 1);
+                        else
+                        if (edge_row[i] < 0)
+                            last  = -1;
+                    }
+
+                    if (first > last)
+                    {
+                        x_end = x_begin;
+                    }
+                    else
+                    {
+                        x_begin = min_x + (first & ~7);
+                        x_end   = min_x +  last + 1;
+                    }
+                }
+
+                double  z_row   = POLICY::depth_test ? double(za) + dz_dy * (y - (*a)[1]) : 0.0;
+                int64_t z_start = 0;
+                int     offset  = y * pitch + x_begin;
+
+                if (POLICY::depth_test && !float_depth)
+                {
+                    z_start = int64_t((z_row + z_plane_x + 0.5) * 4294967296.0);
+                }
+
+                const Depth_Value * tile_farthest = z_tile_farthest.data () + (y / z_tile_size) * z_tile_columns;
+                uint8_t           * tile_dirty    = z_tile_dirty   .data () + (y / z_tile_size) * z_tile_columns;
+                const uint8_t     * tile_cleared  = z_tile_cleared .data () + (y / z_tile_size) * z_tile_columns;
+
+                for (int x = x_begin; x < x_end; x += 8, offset += 8)
+                {
+                    // Los bloques coinciden con los tiles del z-buffer jerárquico, así que si el tile
+                    // está oculto el bloque se salta sin evaluar nada. Por eso las funciones de
+                    // arista y la profundidad se calculan en cada bloque a partir de x en lugar de
+                    // avanzarlas de bloque en bloque:
+
+                    if (POLICY::depth_test && hierarchical_z && !single_tile && Depth_Format::hidden (z_nearest, tile_farthest[x / z_tile_size])) continue;
+
+                    // Máscara de cobertura: carriles cuyas tres funciones de arista no son negativas:
+
+                    const int64_t x_skipped = x - min_x;
+
+                    INT32X8 coverage = INT32X8::negative
+                    (
+                        (INT32X8::set1 (int32_t(edge_row[0] + edge_a[0] * x_skipped)) + edge_lanes[0]) |
+                        (INT32X8::set1 (int32_t(edge_row[1] + edge_a[1] * x_skipped)) + edge_lanes[1]) |
+                        (INT32X8::set1 (int32_t(edge_row[2] + edge_a[2] * x_skipped)) + edge_lanes[2])
+                    );
+
+                    unsigned mask = ~INT32X8::bits (coverage) & 0xFF;
+
+                    if (mask != 0)
+                    {
+                        if (clear_pending && tile_cleared[x / z_tile_size])
+                        {
+                            materialize_clear ((y / z_tile_size) * z_tile_columns + x / z_tile_size);
+                        }
+
+                        DEPTH32X8 z = z_lanes;
+
+                        if constexpr (POLICY::depth_test)
+                        {
+                            if constexpr (float_depth)
+                                z = DEPTH32X8::set1 (float(z_row + dz_dx * (x + 1 - (*a)[0]))) + z_lanes;
+                            else
+                                z = DEPTH32X8::set1 (int32_t((z_start + z_block_step * ((x - plane_x) / 8)) >> 32)) + z_lanes;
+                        }
+
+                        if (x + 8 <= clip.right && (simd_depth_test || !POLICY::depth_test))
+                        {
+                            if constexpr (simd_depth_test)
+                            {
+                                // Test y escritura de profundidad enmascarados sobre los 8 carriles:
+
+                                INT32X8 key;
+
+                                if constexpr (float_depth)
+                                    key = z.to_bits ();
+                                else
+                                if constexpr (Depth_Format::clamped)
+                                    key = INT32X8::max (INT32X8::min (z, INT32X8::set1 (Depth_Format::max_depth)), INT32X8::set1 (0));
+                                else
+                                    key = z;
+
+                                int32_t * stored_depths = reinterpret_cast< int32_t * >(depths + offset);
+
+                                INT32X8 stored = INT32X8::load (stored_depths);
+                                INT32X8 closer = Depth_Format::reversed ? INT32X8::less (stored, key) : INT32X8::less (key, stored);
+                                INT32X8 passed = INT32X8::and_not (coverage, closer);
+
+                                mask = INT32X8::bits (passed);
+
+                                // Si ningún carril pasa no se escribe, para no ensuciar una línea de
+                                // caché que después habría que volcar a memoria sin haber cambiado:
+
+                                if (mask)
+                                {
+                                    if (POLICY::depth_write) INT32X8::select (passed, stored, key).store (stored_depths);
+
+                                    tile_dirty[x / z_tile_size] = 1;
+                                }
+                            }
+
+                            write_span_masked< POLICY > (offset, mask, fill);
+                        }
+                        else
+                        {
+                            // El bloque sobresale del borde derecho de clip (o el formato no admite el
+                            // test con SIMD), así que se completa carril a carril:
+
+                            Depth_Interpolant z_values[8];
+                            unsigned          written = 0;
+
+                            z.store (z_values);
+
+                            for (int k = 0, lanes = std::min (8, clip.right - x); k < lanes; ++k)
+                            {
+                                if (mask & (1u << k))
+                                {
+                                    if (POLICY::depth_test)
+                                    {
+                                        if (!Depth_Format::closer (z_values[k], depths[offset + k])) continue;
+
+                                        if (POLICY::depth_write) depths[offset + k] = Depth_Format::to_value (z_values[k]);
+
+                                        tile_dirty[x / z_tile_size] = 1;
+                                    }
+
+                                    written |= 1u << k;
+                                }
+                            }
+
+                            write_span_masked< POLICY > (offset, written, fill);
+                        }
+                    }
+
+                }
+
+                edge_row[0] += edge_b[0];
+                edge_row[1] += edge_b[1];
+                edge_row[2] += edge_b[2];
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class POLICY >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::fill_triangle_msaa
+        (
+            const Point4i        * const vertices,
+            int                          i0,
+            int                          i1,
+            int                          i2,
+            const Fill_Value     &       fill,
+            const Clip_Rectangle &       clip
+        )
+        {
+            // Posiciones de las muestras en dieciseisavos de píxel (el patrón rotado habitual de 4x)
+            // alrededor del punto en el que se muestrea la cobertura sin MSAA, (x + 1, y):
+
+            static constexpr int sample_x[msaa_samples] = { -2,  6, -6,  2 };
+            static constexpr int sample_y[msaa_samples] = { -6, -2,  2,  6 };
+
+            const Point4i * a = vertices + i0;
+            const Point4i * b = vertices + i1;
+            const Point4i * c = vertices + i2;
+
+            int64_t area = int64_t((*b)[0] - (*a)[0]) * ((*c)[1] - (*a)[1]) - int64_t((*c)[0] - (*a)[0]) * ((*b)[1] - (*a)[1]);
+
+            if (area == 0) return;
+
+            if (area < 0)
+            {
+                std::swap (b, c);
+                std::swap (i1, i2);
+                area = -area;
+            }
+
+            // Las muestras del píxel x están entre x + 1 - 6/16 y x + 1 + 6/16, y las de la fila y
+            // entre y - 6/16 e y + 6/16:
+
+            int min_x = std::max (std::min ({ (*a)[0], (*b)[0], (*c)[0] }) - 1, clip.left  );
+            int max_x = std::min (std::max ({ (*a)[0], (*b)[0], (*c)[0] }),     clip.right );
+            int min_y = std::max (std::min ({ (*a)[1], (*b)[1], (*c)[1] }),     clip.top   );
+            int max_y = std::min (std::max ({ (*a)[1], (*b)[1], (*c)[1] }) + 1, clip.bottom);
+
+            if (min_x >= max_x || min_y >= max_y) return;
+
+            // Funciones de arista en dieciseisavos de píxel, con la misma regla top-left que
+            // fill_triangle_half_space(). En la muestra s del píxel (x, y) valen 16 * A * x + C,
+            // donde C depende de la fila y de la muestra:
+
+            const Point4i * edge_start[3] = { a, b, c };
+            const Point4i * edge_end  [3] = { b, c, a };
+
+            int64_t edge_a   [3];
+            int64_t edge_b   [3];
+            int64_t edge_bias[3];
+
+            for (int i = 0; i < 3; ++i)
+            {
+                edge_a[i] = (*edge_start[i])[1] - (*edge_end[i])[1];
+                edge_b[i] = (*edge_end[i])[0] - (*edge_start[i])[0];
+
+                edge_bias[i] = edge_a[i] > 0 || (edge_a[i] == 0 && edge_b[i] > 0) ? 0 : -1;
+            }
+
+            // Plano de profundidad en píxeles:
+
+            double dz_dx = 0, dz_dy = 0;
+
+            const double za = POLICY::depth_test ? double(vertex_depth (vertices, i0, fill)) : 0.0;
+
+            if (POLICY::depth_test)
+            {
+                double inverse_area = 1.0 / double(area);
+                double dz1 = double(vertex_depth (vertices, i1, fill)) - za;
+                double dz2 = double(vertex_depth (vertices, i2, fill)) - za;
+                double dx1 = double((*b)[0] - (*a)[0]), dx2 = double((*c)[0] - (*a)[0]);
+                double dy1 = double((*b)[1] - (*a)[1]), dy2 = double((*c)[1] - (*a)[1]);
+
+                dz_dx = (dz1 * dy2 - dz2 * dy1) * inverse_area;
+                dz_dy = (dz2 * dx1 - dz1 * dx2) * inverse_area;
+            }
+
+            auto floor_div = [] (int64_t n, int64_t d) { return n >= 0 ? n / d : -((-n + d - 1) / d); };
+
+            const int pitch = color_buffer.get_pitch ();
+
+            for (int y = min_y; y < max_y; ++y)
+            {
+                // Intervalo [first, last) de píxeles de la fila cuya muestra s queda dentro del
+                // triángulo. Cada arista lo limita por un lado según el signo de A:
+
+                int    first[msaa_samples];
+                int    last [msaa_samples];
+                double z_row[msaa_samples];
+
+                for (int s = 0; s < msaa_samples; ++s)
+                {
+                    int64_t low  = min_x;
+                    int64_t high = max_x;
+
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        const Point4i & p = *edge_start[i];
+
+                        int64_t constant = edge_a[i] * (16 + sample_x[s] - 16 * int64_t(p[0]))
+                                         + edge_b[i] * (16 * int64_t(y) + sample_y[s] - 16 * int64_t(p[1]))
+                                         + edge_bias[i];
+
+                        if (edge_a[i] > 0)
+                            low  = std::max (low,  -floor_div (constant, 16 * edge_a[i]));
+                        else
+                        if (edge_a[i] < 0)
+                            high = std::min (high,  floor_div (constant, -16 * edge_a[i]) + 1);
+                        else
+                        if (constant < 0)
+                            high = min_x;
+                    }
+
+                    if (low >= high) low = high = min_x;
+
+                    first[s] = int(low);
+                    last [s] = int(high);
+
+                    z_row[s] = za + dz_dx * ((16 + sample_x[s]) / 16.0 - (*a)[0]) + dz_dy * (y + sample_y[s] / 16.0 - (*a)[1]);
+                }
+
+                int begin = std::min ({ first[0], first[1], first[2], first[3] });
+                int end   = std::max ({ last [0], last [1], last [2], last [3] });
+
+                if (clear_pending && begin < end) materialize_clear (y, begin, end);
+
+                for (int x = begin, offset = y * pitch + begin; x < end; ++x, ++offset)
+                {
+                    unsigned covered = 0;
+
+                    for (int s = 0; s < msaa_samples; ++s)
+                    {
+                        if (x >= first[s] && x < last[s]) covered |= 1u << s;
+                    }
+
+                    unsigned passed = covered;
+
+                    if (POLICY::depth_test && covered)
+                    {
+                        Depth_Value * depths = msaa_depths.data () + offset * msaa_samples;
+
+                        for (unsigned mask = covered; mask; mask &= mask - 1)
+                        {
+                            unsigned          s = simd::count_trailing_zeros (mask);
+                            double            z = z_row[s] + dz_dx * x;
+                            Depth_Interpolant depth;
+
+                            if constexpr (std::is_floating_point< Depth_Interpolant >::value)
+                                depth = Depth_Interpolant(z);
+                            else
+                                depth = Depth_Interpolant(std::nearbyint (std::min (std::max (z, -2147483648.0), 2147483647.0)));
+
+                            if (!Depth_Format::closer (depth, depths[s]))
+                                passed &= ~(1u << s);
+                            else
+                            if (POLICY::depth_write)
+                                depths[s] = Depth_Format::to_value (depth);
+                        }
+                    }
+
+                    if (passed) write_msaa_samples< POLICY > (x, y, offset, passed, fill);
+                }
+            }
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::resolve_msaa (Thread_Pool * pool)
+        {
+            assert(msaa && thread_pool == nullptr);
+
+            resolve_clear ();
+
+            const int width  = int(color_buffer.get_width  ());
+            const int height = int(color_buffer.get_height ());
+            const int pitch  = int(color_buffer.get_pitch  ());
+
+            // Solo se tocan los píxeles expandidos, que son pocos. Cada fila se recorre con SIMD
+            // saltando los tramos sin ninguno, y las muestras de cada tramo de píxeles expandidos
+            // seguidos se copian por planos en resolve_run_size colores a la vez para promediarlas
+            // con una sola llamada a average_samples():
+
+            auto resolve_rows = [&] (int first_row, int last_row)
+            {
+                Color            planes[msaa_samples][resolve_run_size];
+                Color          * colors = color_buffer.colors ();
+                const uint32_t * blocks = msaa_blocks.data ();
+
+                for (int y = first_row; y < last_row; ++y)
+                {
+                    const uint32_t * row = blocks + y * pitch;
+
+                    for (int x = 0; (x = int(simd::find_high_bit (row, size_t(x), size_t(width)))) < width; )
+                    {
+                        int count = 0;
+
+                        for ( ; x + count < width && count < resolve_run_size && (row[x + count] & msaa_expanded_bit); ++count)
+                        {
+                            const Color * samples = msaa_samples_of (x + count, y, row[x + count]);
+
+                            for (int s = 0; s < msaa_samples; ++s) planes[s][count] = samples[s];
+                        }
+
+                        average_samples (colors + y * pitch + x, planes[0], planes[1], planes[2], planes[3], count);
+
+                        x += count;
+                    }
+                }
+            };
+
+            if (pool && height > tile_size)
             {
-                return (color_buffer);
+                pool->run
+                (
+                    unsigned((height + tile_size - 1) / tile_size),
+                    [&] (unsigned , unsigned band)
+                    {
+                        resolve_rows (int(band) * tile_size, std::min (int(band + 1) * tile_size, height));
+                    }
+                );
             }
+            else
+                resolve_rows (0, height);
+        }
 
-        public:
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::average_samples
+        (
+            Color       * target,
+            const Color * s0,
+            const Color * s1,
+            const Color * s2,
+            const Color * s3,
+            int           count
+        )
+        {
+            typedef typename Color::Component_Type Component;
 
-            void set_color (const Color & new_color)
+            if constexpr (std::is_same< Component, uint8_t >::value)
             {
-                color = new_color;
+                simd::average_bytes
+                (
+                    reinterpret_cast< uint8_t       * >(target),
+                    reinterpret_cast< const uint8_t * >(s0),
+                    reinterpret_cast< const uint8_t * >(s1),
+                    reinterpret_cast< const uint8_t * >(s2),
+                    reinterpret_cast< const uint8_t * >(s3),
+                    size_t(count) * sizeof(Color)
+                );
             }
-
-            void set_color (float r, float g, float b)
+            else
+            if constexpr (std::is_void< Component >::value)
             {
-                color_buffer.set (r, g, b);
+                for (int index = 0; index < count; ++index)
+                {
+                    target[index].value = average_packed< 0 > (s0[index], s1[index], s2[index], s3[index]);
+                }
             }
-
-            void clear ()
+            else
             {
-                color_buffer.clear ({ 0, 0, 0 });
-
-                for (int * z = z_buffer.data (), * end = z + z_buffer.size (); z != end; z++)
+                for (int index = 0; index < count; ++index)
                 {
-                    *z = std::numeric_limits< int >::max ();
+                    for (unsigned i = 0; i < Color::component_count; ++i)
+                    {
+                        if constexpr (std::is_floating_point< Component >::value)
+                        {
+                            target[index].components[i] = (s0[index].components[i] + s1[index].components[i] + s2[index].components[i] + s3[index].components[i]) * Component(0.25);
+                        }
+                        else
+                        {
+                            uint64_t sum = uint64_t(s0[index].components[i]) + s1[index].components[i] + s2[index].components[i] + s3[index].components[i];
+
+                            target[index].components[i] = Component((sum + 2) / 4);
+                        }
+                    }
                 }
             }
+        }
 
-            void fill_convex_polygon
-            (
-                const Point4i * const vertices, 
-                const int     * const indices_begin, 
-                const int     * const indices_end
-            );
-
-            void fill_convex_polygon_z_buffer
-            (
-                const Point4i * const vertices, 
-                const int     * const indices_begin, 
-                const int     * const indices_end
-            );
-
-        private:
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< unsigned COMPONENT >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Color::Composite_Type Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::average_packed
+        (
+            const Color & s0,
+            const Color & s1,
+            const Color & s2,
+            const Color & s3
+        )
+        {
+            typedef typename Color::Composite_Type                          Composite;
+            typedef typename Color::template Component_Traits< COMPONENT >  Traits;
 
-            template< typename VALUE_TYPE, size_t SHIFT >
-            void interpolate (int * cache, int v0, int v1, int y_min, int y_max);
+            uint64_t sum = uint64_t((s0.value >> Traits::shift) & Traits::mask)
+                         + uint64_t((s1.value >> Traits::shift) & Traits::mask)
+                         + uint64_t((s2.value >> Traits::shift) & Traits::mask)
+                         + uint64_t((s3.value >> Traits::shift) & Traits::mask);
 
-        };
+            Composite result = Composite(Composite((sum + 2) / 4) << Traits::shift);
 
-        template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::offset_cache0[2160];
-        template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::offset_cache1[2160];
+            if constexpr (COMPONENT + 1 < Color::component_count)
+            {
+                result = Composite(result | average_packed< COMPONENT + 1 > (s0, s1, s2, s3));
+            }
 
-        template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::z_cache0[2160];
-        template< class COLOR_BUFFER_TYPE > int Rasterizer< COLOR_BUFFER_TYPE >::z_cache1[2160];
+            return result;
+        }
 
-        template< class  COLOR_BUFFER_TYPE >
-        void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::setup_attributes
         (
-            const Point4i * const vertices, 
-            const int     * const indices_begin, 
-            const int     * const indices_end
+            const Point4i   * const vertices,
+            const int       * const indices_begin,
+            const int       * const indices_end,
+            Attribute_Setup &       setup
         )
+        const
         {
-            // Se cachean algunos valores de interés:
-
-                  int   pitch         = color_buffer.get_width ();
-                  int * offset_cache0 = this->offset_cache0;
-                  int * offset_cache1 = this->offset_cache1;
-            const int * indices_back  = indices_end - 1;
-
-            // Se busca el vértice de inicio (el que tiene menor Y) y el de terminación (el que tiene mayor Y):
+            // Los gradientes se calculan con el triángulo del abanico de mayor área, que es el que
+            // menos error introduce:
 
-            const int * start_index   = indices_begin;
-                  int   start_y       = vertices[*start_index][1];
-            const int * end_index     = indices_begin;
-                  int   end_y         = start_y;
+            const int * a = indices_begin;
+            const int * b = indices_begin + 1;
+            int64_t     area = 0;
 
-            for (const int * index_iterator = start_index; ++index_iterator < indices_end; )
+            for (const int * index = indices_begin + 1; index + 1 < indices_end; ++index)
             {
-                int current_y = vertices[*index_iterator][1];
+                const Point4i & v0 = vertices[*a], & v1 = vertices[index[0]], & v2 = vertices[index[1]];
 
-                if (current_y < start_y)
-                {
-                    start_y     = current_y; 
-                    start_index = index_iterator;
-                }
-                else
-                if (current_y > end_y)
+                int64_t current = int64_t(v1[0] - v0[0]) * (v2[1] - v0[1]) - int64_t(v2[0] - v0[0]) * (v1[1] - v0[1]);
+
+                if (std::abs (current) > std::abs (area))
                 {
-                    end_y       = current_y;
-                    end_index   = index_iterator;
+                    area = current;
+                    b    = index;
                 }
             }
 
-            // Se cachean las coordenadas X de los lados que van desde el vértice con Y menor al
-            // vértice con Y mayor en sentido antihorario:
+            const int       ia = *a, ib = b[0], ic = b[1];
+            const Point4i & va = vertices[ia];
+            const Point4i & vb = vertices[ib];
+            const Point4i & vc = vertices[ic];
 
-            const int * current_index = start_index;
-            const int *    next_index = start_index > indices_begin ? start_index - 1 : indices_back;
+            setup.shading  = shading;
+            setup.origin_x = va[0];
+            setup.origin_y = va[1];
+            setup.count    = attribute_count;
 
-            int y0 = vertices[*current_index][1];
-            int y1 = vertices[*   next_index][1];
-            int o0 = vertices[*current_index][0] + y0 * pitch;
-            int o1 = vertices[*   next_index][0] + y1 * pitch;
+            const double dx1 = double(vb[0] - va[0]), dx2 = double(vc[0] - va[0]);
+            const double dy1 = double(vb[1] - va[1]), dy2 = double(vc[1] - va[1]);
+            const double inverse_area = area != 0 ? 1.0 / double(area) : 0.0;
 
-            while (true)
+            for (unsigned i = 0; i <= attribute_count; ++i)
             {
-                interpolate< int64_t, 32 > (offset_cache0, o0, o1, y0, y1);
+                // El plano 0 es 1/w y los demás cada atributo multiplicado por 1/w:
 
-                if (current_index == indices_begin) current_index = indices_back; else current_index--;
-                if (current_index == end_index    ) break;
-                if (   next_index == indices_begin) next_index    = indices_back; else    next_index--;
+                double qa = attribute_inverse_w[ia];
+                double qb = attribute_inverse_w[ib];
+                double qc = attribute_inverse_w[ic];
 
-                y0 = y1;
-                y1 = vertices[*next_index][1];
-                o0 = o1;
-                o1 = vertices[*next_index][0] + y1 * pitch;
+                double fa = i == 0 ? qa : qa * attribute_values[size_t(ia) * attribute_count + i - 1];
+                double fb = i == 0 ? qb : qb * attribute_values[size_t(ib) * attribute_count + i - 1];
+                double fc = i == 0 ? qc : qc * attribute_values[size_t(ic) * attribute_count + i - 1];
+
+                double df1 = fb - fa, df2 = fc - fa;
+
+                setup.value[i] = fa;
+                setup.dx   [i] = (df1 * dy2 - df2 * dy1) * inverse_area;
+                setup.dy   [i] = (df2 * dx1 - df1 * dx2) * inverse_area;
             }
+        }
 
-            int end_offset = o1;
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class FLOAT32X8 >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::shade_block (int offset, unsigned lanes, const Fill_Value & fill, Color * colors) const
+        {
+            static const float lane_indices[8] = { 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
 
-            // Se cachean las coordenadas X de los lados que van desde el vértice con Y menor al
-            // vértice con Y mayor en sentido horario:
+            const Attribute_Setup & setup = *fill.setup;
 
-            current_index = start_index;
-               next_index = start_index < indices_back ? start_index + 1 : indices_begin;
+            // Los planos se evalúan en el mismo punto que la cobertura, (x + 1, y). El comienzo del
+            // bloque se calcula en double y los carriles se desplazan en float:
 
-            y0 = vertices[*current_index][1];
-            y1 = vertices[*   next_index][1];
-            o0 = vertices[*current_index][0] + y0 * pitch;
-            o1 = vertices[*   next_index][0] + y1 * pitch;
+            const int    pitch  = int(color_buffer.get_pitch ());
+            const int    y      = offset / pitch;
+            const int    x      = offset - y * pitch;
+            const double column = double(x + 1 - setup.origin_x);
+            const double row    = double(y     - setup.origin_y);
 
-            while (true)
+            const FLOAT32X8 lane = FLOAT32X8::load (lane_indices);
+
+            auto evaluate = [&] (unsigned i)
             {
-                interpolate< int64_t, 32 > (offset_cache1, o0, o1, y0, y1);
+                return FLOAT32X8::set1 (float(setup.value[i] + setup.dx[i] * column + setup.dy[i] * row))
+                     + FLOAT32X8::set1 (float(setup.dx[i])) * lane;
+            };
 
-                if (current_index == indices_back) current_index = indices_begin; else current_index++;
-                if (current_index == end_index   ) break;
-                if (   next_index == indices_back) next_index    = indices_begin; else next_index++;
+            const FLOAT32X8 w = FLOAT32X8::set1 (1.f) / evaluate (0);
 
-                y0 = y1;
-                y1 = vertices[*next_index][1];
-                o0 = o1;
-                o1 = vertices[*next_index][0] + y1 * pitch;
+            float attributes[max_attributes][8];
+
+            for (unsigned i = 0; i < setup.count; ++i)
+            {
+                (evaluate (i + 1) * w).store (attributes[i]);
             }
 
-            if (o1 > end_offset) end_offset = o1;
+            // Nivel de mipmap de cada quad de 2x2 píxeles. Las derivadas de u = Au / q en pantalla
+            // son (dAu - u * dq) / q y se evalúan en el centro del quad, de modo que los cuatro
+            // píxeles usan el mismo nivel. Los carriles se desplazan hasta el centro de su quad
+            // según la paridad de la columna y la fila:
 
-            // Se rellenan las scanlines desde la que tiene menor Y hasta la que tiene mayor Y:
+            unsigned levels[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
 
-            offset_cache0 += start_y;
-            offset_cache1 += start_y;
+            const Texture * texture = setup.shading.texture;
 
-            for (int y = start_y; y < end_y; y++)
+            if (texture && texture->get_level_count () > 1)
             {
-                o0 = *offset_cache0++;
-                o1 = *offset_cache1++;
+                static const float quad_even[8] = { 0.5f, 0.5f, 2.5f, 2.5f, 4.5f, 4.5f, 6.5f, 6.5f };
+                static const float quad_odd [8] = {-0.5f, 1.5f, 1.5f, 3.5f, 3.5f, 5.5f, 5.5f, 7.5f };
 
-                if (o0 < o1)
-                {
-                    while (o0 < o1) color_buffer.set_pixel (o0++);
+                const FLOAT32X8 quad_lane = FLOAT32X8::load ((x & 1) ? quad_odd : quad_even);
+                const double    quad_row  = row + ((y & 1) ? -0.5 : 0.5);
 
-                    if (o0 > end_offset) break;
-                }
-                else
+                auto evaluate_quad = [&] (unsigned i)
                 {
-                    while (o1 < o0) color_buffer.set_pixel (o1++);
-
-                    if (o1 > end_offset) break;
+                    return FLOAT32X8::set1 (float(setup.value[i] + setup.dx[i] * column + setup.dy[i] * quad_row))
+                         + FLOAT32X8::set1 (float(setup.dx[i])) * quad_lane;
+                };
+
+                const unsigned  iu = unsigned(setup.shading.uv_attribute) + 1;
+                const unsigned  iv = iu + 1;
+                const FLOAT32X8 qw = FLOAT32X8::set1 (1.f) / evaluate_quad (0);
+                const FLOAT32X8 u  = evaluate_quad (iu) * qw;
+                const FLOAT32X8 v  = evaluate_quad (iv) * qw;
+                const FLOAT32X8 dq_dx = FLOAT32X8::set1 (float(setup.dx[0]));
+                const FLOAT32X8 dq_dy = FLOAT32X8::set1 (float(setup.dy[0]));
+                const FLOAT32X8 width  = FLOAT32X8::set1 (float(texture->get_width  ())) * qw;
+                const FLOAT32X8 height = FLOAT32X8::set1 (float(texture->get_height ())) * qw;
+
+                const FLOAT32X8 du_dx = (FLOAT32X8::set1 (float(setup.dx[iu])) - u * dq_dx) * width;
+                const FLOAT32X8 du_dy = (FLOAT32X8::set1 (float(setup.dy[iu])) - u * dq_dy) * width;
+                const FLOAT32X8 dv_dx = (FLOAT32X8::set1 (float(setup.dx[iv])) - v * dq_dx) * height;
+                const FLOAT32X8 dv_dy = (FLOAT32X8::set1 (float(setup.dy[iv])) - v * dq_dy) * height;
+
+                float rho_squared[8];
+
+                FLOAT32X8::max (du_dx * du_dx + dv_dx * dv_dx, du_dy * du_dy + dv_dy * dv_dy).store (rho_squared);
+
+                for (unsigned k = 0; k < 8; ++k)
+                {
+                    levels[k] = texture->select_level (rho_squared[k]);
                 }
             }
+
+            for ( ; lanes; lanes &= lanes - 1)
+            {
+                unsigned k = simd::count_trailing_zeros (lanes);
+
+                colors[k] = shade_fragment (setup.shading, fill.color, attributes, k, levels[k]);
+            }
         }
 
-        template< class  COLOR_BUFFER_TYPE >
-        void Rasterizer< COLOR_BUFFER_TYPE >::fill_convex_polygon_z_buffer
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        typename Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::Color Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::shade_fragment
         (
-            const Point4i * const vertices, 
-            const int     * const indices_begin, 
-            const int     * const indices_end
+            const Shading &       shading,
+            const Color   &       base,
+            const float  (*       attributes)[8],
+            unsigned              lane,
+            unsigned              level
         )
         {
-            // Se cachean algunos valores de interés:
+            Color result = base;
 
-                  int   pitch         = color_buffer.get_width ();
-                  int * offset_cache0 = this->offset_cache0;
-                  int * offset_cache1 = this->offset_cache1;
-                  int * z_cache0      = this->z_cache0;
-                  int * z_cache1      = this->z_cache1;
-            const int * indices_back  = indices_end - 1;
+            if (shading.texture)
+            {
+                result = shading.texture->sample (attributes[shading.uv_attribute][lane], attributes[shading.uv_attribute + 1][lane], level);
+            }
 
-            // Se busca el vértice de inicio (el que tiene menor Y) y el de terminación (el que tiene mayor Y):
+            if (shading.color_attribute < 0 && shading.normal_attribute < 0) return result;
 
-            const int * start_index   = indices_begin;
-                  int   start_y       = vertices[*start_index][1];
-            const int * end_index     = indices_begin;
-                  int   end_y         = start_y;
+            float red = 1.f, green = 1.f, blue = 1.f;
 
-            for (const int * index_iterator = start_index; ++index_iterator < indices_end; )
+            if (shading.color_attribute >= 0)
             {
-                int current_y = vertices[*index_iterator][1];
+                red   = attributes[shading.color_attribute + 0][lane];
+                green = attributes[shading.color_attribute + 1][lane];
+                blue  = attributes[shading.color_attribute + 2][lane];
+            }
 
-                if (current_y < start_y)
-                {
-                    start_y     = current_y; 
-                    start_index = index_iterator;
-                }
-                else
-                if (current_y > end_y)
-                {
-                    end_y       = current_y;
-                    end_index   = index_iterator;
-                }
+            if (shading.normal_attribute >= 0)
+            {
+                // Las normales interpoladas no tienen longitud unidad, así que se normaliza el
+                // producto escalar:
+
+                Vector3f normal
+                (
+                    attributes[shading.normal_attribute + 0][lane],
+                    attributes[shading.normal_attribute + 1][lane],
+                    attributes[shading.normal_attribute + 2][lane]
+                );
+
+                float length    = glm::length (normal);
+                float diffuse   = length > 0.f ? std::max (glm::dot (normal, shading.light_direction) / length, 0.f) : 0.f;
+                float intensity = shading.ambient + (1.f - shading.ambient) * diffuse;
+
+                red   *= intensity;
+                green *= intensity;
+                blue  *= intensity;
             }
 
-            // Se cachean las coordenadas X de los lados que van desde el vértice con Y menor al
-            // vértice con Y mayor en sentido antihorario:
+            modulate (result, red, green, blue);
 
-            const int * current_index = start_index;
-            const int *    next_index = start_index > indices_begin ? start_index - 1 : indices_back;
+            return result;
+        }
 
-            int y0 = vertices[*current_index][1];
-            int y1 = vertices[*   next_index][1];
-            int z0 = vertices[*current_index][2];
-            int z1 = vertices[*   next_index][2];
-            int o0 = vertices[*current_index][0] + y0 * pitch;
-            int o1 = vertices[*   next_index][0] + y1 * pitch;
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::modulate (Color & color, float red, float green, float blue)
+        {
+            // Los factores se acotan a [0, 1] (los NaN quedan en 0). El alfa no se modifica:
 
-            while (true)
+            red   = std::max (0.f, std::min (red,   1.f));
+            green = std::max (0.f, std::min (green, 1.f));
+            blue  = std::max (0.f, std::min (blue,  1.f));
+
+            typedef typename Color::Component_Type Component;
+
+            if constexpr (std::is_void< Component >::value)
             {
-                interpolate< int64_t, 32 > (offset_cache0, o0, o1, y0, y1);
-                interpolate< int32_t,  0 > (     z_cache0, z0, z1, y0, y1);
+                typedef typename Color::Composite_Type Composite;
 
-                if (current_index == indices_begin) current_index = indices_back; else current_index--;
-                if (current_index == end_index    ) break;
-                if (   next_index == indices_begin) next_index    = indices_back; else    next_index--;
+                auto scale = [&color] (auto traits, float factor)
+                {
+                    typedef decltype(traits) Traits;
 
-                y0 = y1;
-                y1 = vertices[*next_index][1];
-                z0 = z1;
-                z1 = vertices[*next_index][2];
-                o0 = o1;
-                o1 = vertices[*next_index][0] + y1 * pitch;
-            }
+                    Composite component = (color.value >> Traits::shift) & Traits::mask;
+                    Composite scaled    = Composite(float(component) * factor + 0.5f);
 
-            int end_offset = o1;
+                    color.value = Composite((color.value & ~Composite(Traits::mask << Traits::shift)) | (scaled << Traits::shift));
+                };
 
-            // Se cachean las coordenadas X de los lados que van desde el vértice con Y menor al
-            // vértice con Y mayor en sentido horario:
+                scale (typename Color::  red_traits(), red  );
+                scale (typename Color::green_traits(), green);
+                scale (typename Color:: blue_traits(), blue );
+            }
+            else
+            if constexpr (std::is_floating_point< Component >::value)
+            {
+                color.red   () *= red;
+                color.green () *= green;
+                color.blue  () *= blue;
+            }
+            else
+            {
+                color.red   () = Component(float(color.red   ()) * red   + 0.5f);
+                color.green () = Component(float(color.green ()) * green + 0.5f);
+                color.blue  () = Component(float(color.blue  ()) * blue  + 0.5f);
+            }
+        }
 
-            current_index = start_index;
-               next_index = start_index < indices_back ? start_index + 1 : indices_begin;
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        bool Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::is_polygon_visible
+        (
+            const Point4i        * const vertices, 
+            const int            * const indices_begin, 
+            const int            * const indices_end,
+            const Fill_Value     &       fill,
+            const Clip_Rectangle &       clip
+        )
+        {
+            const Point4i & first = vertices[*indices_begin];
 
-            y0 = vertices[*current_index][1];
-            y1 = vertices[*   next_index][1];
-            z0 = vertices[*current_index][2];
-            z1 = vertices[*   next_index][2];
-            o0 = vertices[*current_index][0] + y0 * pitch;
-            o1 = vertices[*   next_index][0] + y1 * pitch;
+            int               min_x     = first[0], max_x = first[0];
+            int               min_y     = first[1], max_y = first[1];
+            Depth_Interpolant z_nearest = vertex_depth (vertices, *indices_begin, fill);
 
-            while (true)
+            for (const int * index = indices_begin; ++index < indices_end; )
             {
-                interpolate< int64_t, 32 > (offset_cache1, o0, o1, y0, y1);
-                interpolate< int32_t,  0 > (     z_cache1, z0, z1, y0, y1);
-
-                if (current_index == indices_back) current_index = indices_begin; else current_index++;
-                if (current_index == end_index   ) break;
-                if (   next_index == indices_back) next_index    = indices_begin; else next_index++;
+                const Point4i & vertex = vertices[*index];
 
-                y0 = y1;
-                y1 = vertices[*next_index][1];
-                z0 = z1;
-                z1 = vertices[*next_index][2];
-                o0 = o1;
-                o1 = vertices[*next_index][0] + y1 * pitch;
+                min_x = std::min (min_x, vertex[0]);
+                max_x = std::max (max_x, vertex[0]);
+                min_y = std::min (min_y, vertex[1]);
+                max_y = std::max (max_y, vertex[1]);
+                z_nearest = Depth_Format::nearest (z_nearest, vertex_depth (vertices, *index, fill));
             }
 
-            if (o1 > end_offset) end_offset = o1;
+            min_x = std::max (min_x, clip.left );
+            min_y = std::max (min_y, clip.top  );
+            max_x = std::min (max_x, clip.right );
+            max_y = std::min (max_y, clip.bottom);
+
+            if (min_x >= max_x || min_y >= max_y) return false;
 
-            // Se rellenan las scanlines desde la que tiene menor Y hasta la que tiene mayor Y:
+            return is_area_visible (min_x, min_y, max_x, max_y, z_nearest);
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        bool Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::is_area_visible (int min_x, int min_y, int max_x, int max_y, Depth_Interpolant z_nearest)
+        {
+            // Se recorren todos los tiles del área (y no solo hasta encontrar uno visible) para
+            // dejar actualizada la cota de los que estaban marcados antes de empezar a rellenar:
 
-            offset_cache0 += start_y;
-            offset_cache1 += start_y;
-            z_cache0 += start_y;
-            z_cache1 += start_y;
+            bool visible = false;
 
-            for (int y = start_y; y < end_y; y++)
+            for (int row = min_y / z_tile_size, last_row = (max_y - 1) / z_tile_size; row <= last_row; ++row)
             {
-                o0 = *offset_cache0++;
-                o1 = *offset_cache1++;
-                z0 = *z_cache0++;
-                z1 = *z_cache1++;
-
-                if (o0 < o1)
+                for (int column = min_x / z_tile_size, last_column = (max_x - 1) / z_tile_size; column <= last_column; ++column)
                 {
-                    int z_step = (z1 - z0) / (o1 - o0);
+                    int tile_index = row * z_tile_columns + column;
 
-                    while (o0 < o1)
+                    if (Depth_Format::hidden (z_nearest, z_tile_farthest[tile_index])) continue;
+
+                    if (z_tile_dirty[tile_index])
                     {
-                        if (o0 >= 0 && o0 < z_buffer.size() && z0 < z_buffer[o0])
-                        {
-                            color_buffer.set_pixel(o0, color);
-                            z_buffer[o0] = z0;
-                        }
+                        refresh_z_tile (tile_index);
 
-                        z0 += z_step;
-                        o0++;
+                        if (Depth_Format::hidden (z_nearest, z_tile_farthest[tile_index])) continue;
                     }
 
-                    if (o0 > end_offset) break;
+                    visible = true;
                 }
-                else
-                if (o1 < o0)
+            }
+
+            return visible;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::refresh_z_tile (int tile_index)
+        {
+            int         pitch    = color_buffer.get_pitch ();
+            int         left     = (tile_index % z_tile_columns) * z_tile_size;
+            int         top      = (tile_index / z_tile_columns) * z_tile_size;
+            int         right    = std::min (left + z_tile_size, int(color_buffer.get_width ()));
+            int         bottom   = std::min (top  + z_tile_size, int(color_buffer.get_height ()));
+            Depth_Value farthest = z_buffer[size_t(top * pitch + left)];
+
+            for (int y = top; y < bottom; ++y)
+            {
+                const Depth_Value * depths = z_buffer.data () + y * pitch;
+
+                for (int x = left; x < right; ++x) farthest = Depth_Format::farthest (farthest, depths[x]);
+            }
+
+            z_tile_farthest[tile_index] = farthest;
+            z_tile_dirty[tile_index] = 0;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::materialize_clear (int tile_index)
+        {
+            int pitch  = color_buffer.get_pitch ();
+            int left   = (tile_index % z_tile_columns) * z_tile_size;
+            int top    = (tile_index / z_tile_columns) * z_tile_size;
+            int right  = std::min (left + z_tile_size, int(color_buffer.get_width ()));
+            int bottom = std::min (top  + z_tile_size, int(color_buffer.get_height ()));
+
+            for (int y = top; y < bottom; ++y)
+            {
+                Depth_Value * depths = z_buffer.data () + y * pitch;
+
+                color_buffer.fill_span (y * pitch + left, right - left, clear_color);
+
+                if (!visibility_buffer.empty ())
                 {
-                    int z_step = (z0 - z1) / (o0 - o1);
+                    std::fill_n (visibility_buffer.data () + y * pitch + left, right - left, Visibility_Sample{ no_triangle, 0 });
+                }
+
+                if (!msaa_blocks.empty ())
+                {
+                    std::fill_n (msaa_blocks.data () + y * pitch + left, right - left, no_msaa_block);
+                    std::fill_n (msaa_depths.data () + (y * pitch + left) * msaa_samples, (right - left) * msaa_samples, Depth_Format::far_value ());
+                }
+
+                std::fill (depths + left, depths + right, Depth_Format::far_value ());
+            }
+
+            z_tile_cleared[tile_index] = 0;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::resolve_clear ()
+        {
+            if (!clear_pending) return;
+
+            for (int tile_index = 0, tile_count = int(z_tile_cleared.size ()); tile_index < tile_count; ++tile_index)
+            {
+                if (z_tile_cleared[tile_index]) materialize_clear (tile_index);
+            }
+
+            clear_pending = false;
+        }
+
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        template< class SHADER >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::resolve_visibility (SHADER && shader, Thread_Pool * pool)
+        {
+            assert(visibility_mode && thread_pool == nullptr);
+
+            resolve_clear ();
+
+            const int width  = int(color_buffer.get_width  ());
+            const int height = int(color_buffer.get_height ());
+            const int pitch  = int(color_buffer.get_pitch  ());
+
+            auto resolve_rows = [&] (int first_row, int last_row)
+            {
+                Color                   * colors  = color_buffer.colors ();
+                const Visibility_Sample * samples = visibility_buffer.data ();
 
-                    while (o1 < o0)
+                for (int y = first_row; y < last_row; ++y)
+                {
+                    for (int x = 0, offset = y * pitch; x < width; ++x, ++offset)
                     {
-                        if (o1 >= 0 && o1 < z_buffer.size() && z1 < z_buffer[o1])
+                        if (samples[offset].triangle_id != no_triangle)
                         {
-                            color_buffer.set_pixel(o1, color);
-                            z_buffer[o1] = z1;
+                            colors[offset] = shader (samples[offset], x, y);
                         }
-
-                        z1 += z_step;
-                        o1++;
                     }
-
-                    if (o1 > end_offset) break;
                 }
+            };
+
+            if (pool && height > tile_size)
+            {
+                pool->run
+                (
+                    unsigned((height + tile_size - 1) / tile_size),
+                    [&] (unsigned , unsigned band)
+                    {
+                        resolve_rows (int(band) * tile_size, std::min (int(band + 1) * tile_size, height));
+                    }
+                );
             }
+            else
+                resolve_rows (0, height);
         }
 
-        template< class  COLOR_BUFFER_TYPE >
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
         template< typename VALUE_TYPE, size_t SHIFT >
-        void Rasterizer< COLOR_BUFFER_TYPE >::interpolate (int * cache, int v0, int v1, int y_min, int y_max)
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::interpolate (int * cache, int v0, int v1, int y_min, int y_max, int clip_top, int clip_bottom)
         {
-            if (y_max > y_min)
+            if (y_max > y_min && y_max >= clip_top && y_min <= clip_bottom)
             {
-                VALUE_TYPE value = (VALUE_TYPE(     v0) << SHIFT);
-                VALUE_TYPE step  = (VALUE_TYPE(v1 - v0) << SHIFT) / (y_max - y_min);
+                VALUE_TYPE value = VALUE_TYPE(     v0) * (VALUE_TYPE(1) << SHIFT);
+                VALUE_TYPE step  = VALUE_TYPE(v1 - v0) * (VALUE_TYPE(1) << SHIFT) / (y_max - y_min);
+
+                // Se salta directamente a la primera fila visible y se termina en la última:
+
+                if (y_min < clip_top)
+                {
+                    value += step * (clip_top - y_min);
+                    y_min  = clip_top;
+                }
+
+                if (y_max > clip_bottom) y_max = clip_bottom;
 
                 for (int * iterator = cache + y_min, * end = cache + y_max; iterator <= end; )
                 {
@@ -396,6 +3072,34 @@
             }
         }
 
+        template< class  COLOR_BUFFER_TYPE, class DEPTH_FORMAT >
+        void Rasterizer< COLOR_BUFFER_TYPE, DEPTH_FORMAT >::interpolate (float * cache, float v0, float v1, int y_min, int y_max, int clip_top, int clip_bottom)
+        {
+            // Igual que la versión entera, pero acumulando en double:
+
+            if (y_max > y_min && y_max >= clip_top && y_min <= clip_bottom)
+            {
+                double step  = (double(v1) - double(v0)) / (y_max - y_min);
+                double value = v0;
+
+                if (y_min < clip_top)
+                {
+                    value += step * (clip_top - y_min);
+                    y_min  = clip_top;
+                }
+
+                if (y_max > clip_bottom) y_max = clip_bottom;
+
+                for (float * iterator = cache + y_min, * end = cache + y_max; iterator <= end; )
+                {
+                   *iterator++ = float(value);
+                    value += step;
+                   *iterator++ = float(value);
+                    value += step;
+                }
+            }
+        }
+
     }
 
 #endif
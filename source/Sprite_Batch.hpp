@@ -0,0 +1,274 @@
+// Este código es de dominio público.
+
+#ifndef SPRITE_BATCH_HEADER
+#define SPRITE_BATCH_HEADER
+
+    #include <algorithm>
+    #include <cassert>
+    #include <cstdint>
+    #include <vector>
+    #include "Blitter.hpp"
+    #include "Thread_Pool.hpp"
+
+    namespace example
+    {
+
+        /** Compone de una vez muchos blits de sprites (glifos, iconos, elementos de interfaz...)
+          * sobre un color buffer. add() solo graba cada blit. draw() los reparte en franjas
+          * horizontales de band_height filas y dibuja las franjas en paralelo con el thread pool,
+          * cada una con un Blitter recortado a sus filas. Dentro de una franja los sprites se
+          * dibujan en el orden en que se añadieron, así que cada píxel recibe las mezclas en el
+          * mismo orden que si se hubiesen hecho los blits uno a uno.
+          *
+          * Los color buffers de origen deben seguir existiendo y sin cambios hasta que termine
+          * draw(). Conviene que el destino tenga filas con relleno (argb::Allocation_Policy::
+          * padded()) para que dos franjas nunca compartan una línea de caché.
+          */
+        template< class COLOR >
+        class Sprite_Batch
+        {
+        public:
+
+            typedef COLOR                           Color;
+            typedef argb::Color_Buffer< Color >     Color_Buffer;
+            typedef argb::Blitter< Color >          Blitter;
+            typedef typename Blitter::Transform     Transform;
+
+            // Las mezclas con alpha solo existen para los formatos de 4 componentes de 8 bits:
+
+            enum class Blend_Mode
+            {
+                REPLACE,
+                HALF,
+                SOURCE_OVER,
+                PREMULTIPLIED,
+                ADDITIVE,
+                MULTIPLY
+            };
+
+            static constexpr bool alpha_blending = argb::internal::is_alpha8888< Color > ();
+
+        private:
+
+            struct Sprite
+            {
+                const Color_Buffer * atlas;
+                int                  x, y;              // Posición en el destino
+                unsigned             slice_left_x;
+                unsigned             slice_top_y;
+                unsigned             slice_width;
+                unsigned             slice_height;
+                Blend_Mode           blend_mode;
+                Transform            transform;
+            };
+
+        private:
+
+            int                     band_height;
+
+            std::vector< Sprite   > sprites;
+
+            // Índices de los sprites de cada franja, guardados seguidos franja tras franja. Los
+            // de la franja b están en [band_offsets[b], band_offsets[b + 1]):
+
+            std::vector< unsigned > band_offsets;
+            std::vector< unsigned > band_sprites;
+            std::vector< unsigned > band_cursors;
+
+        public:
+
+            Sprite_Batch(unsigned band_height = 32)
+            :
+                band_height(int(std::max (band_height, 1u)))
+            {
+            }
+
+        public:
+
+            unsigned get_sprite_count () const
+            {
+                return unsigned(sprites.size ());
+            }
+
+            /** Graba el blit del rectángulo (slice_left_x, slice_top_y, slice_width, slice_height)
+              * de atlas en (x, y), con las mismas reglas que argb::Blitter::blit_slice().
+              */
+            void add
+            (
+                const Color_Buffer & atlas,
+                int                  x,
+                int                  y,
+                unsigned             slice_left_x,
+                unsigned             slice_top_y,
+                unsigned             slice_width,
+                unsigned             slice_height,
+                Blend_Mode           blend_mode = Blend_Mode::REPLACE,
+                Transform            transform  = Transform::NONE
+            )
+            {
+                assert(alpha_blending || blend_mode == Blend_Mode::REPLACE || blend_mode == Blend_Mode::HALF);
+                assert(slice_left_x + slice_width  <= atlas.get_width  ());
+                assert(slice_top_y  + slice_height <= atlas.get_height ());
+
+                sprites.push_back ({ &atlas, x, y, slice_left_x, slice_top_y, slice_width, slice_height, blend_mode, transform });
+            }
+
+            void add (const Color_Buffer & bitmap, int x, int y, Blend_Mode blend_mode = Blend_Mode::REPLACE, Transform transform = Transform::NONE)
+            {
+                add (bitmap, x, y, 0, 0, bitmap.get_width (), bitmap.get_height (), blend_mode, transform);
+            }
+
+            /** Dibuja todos los sprites grabados en target. Sin thread pool las franjas se dibujan
+              * en el hilo que llama. Los sprites grabados se conservan hasta llamar a clear().
+              */
+            void draw (Color_Buffer & target, Thread_Pool * pool = nullptr);
+
+            void clear ()
+            {
+                sprites.clear ();
+            }
+
+        private:
+
+            void sort_into_bands (int target_width, int target_height);
+
+            static void draw_sprite (Blitter & blitter, const Sprite & sprite);
+
+            template< argb::blend_function< COLOR > BLEND_FUNCTION >
+            static void blit_sprite (Blitter & blitter, const Sprite & sprite)
+            {
+                blitter.template blit_slice< BLEND_FUNCTION >
+                (
+                    sprite.x,
+                    sprite.y,
+                    sprite.slice_left_x,
+                    sprite.slice_top_y,
+                    sprite.slice_width,
+                    sprite.slice_height,
+                   *sprite.atlas,
+                    sprite.transform
+                );
+            }
+
+        };
+
+        template< class COLOR >
+        void Sprite_Batch< COLOR >::draw (Color_Buffer & target, Thread_Pool * pool)
+        {
+            if (sprites.empty ()) return;
+
+            const int width  = int(target.get_width  ());
+            const int height = int(target.get_height ());
+
+            sort_into_bands (width, height);
+
+            auto draw_band = [&] (unsigned , unsigned band)
+            {
+                const unsigned first = band_offsets[band    ];
+                const unsigned last  = band_offsets[band + 1];
+
+                if (first == last) return;
+
+                Blitter blitter(target);
+
+                blitter.set_clip (0, int(band) * band_height, width, std::min (int(band + 1) * band_height, height));
+
+                for (unsigned index = first; index < last; ++index)
+                {
+                    draw_sprite (blitter, sprites[band_sprites[index]]);
+                }
+            };
+
+            const unsigned band_count = unsigned(band_offsets.size () - 1);
+
+            if (pool && pool->get_worker_count () > 1 && band_count > 1)
+            {
+                pool->run (band_count, draw_band);
+            }
+            else
+            {
+                for (unsigned band = 0; band < band_count; ++band) draw_band (0, band);
+            }
+        }
+
+        template< class COLOR >
+        void Sprite_Batch< COLOR >::sort_into_bands (int target_width, int target_height)
+        {
+            const int band_count = (target_height + band_height - 1) / band_height;
+
+            // Franjas [first, last] que toca cada sprite, o first > last si queda fuera:
+
+            auto band_range = [&] (const Sprite & sprite, int & first, int & last)
+            {
+                const bool    rotated = sprite.transform == Transform::ROTATE_90 || sprite.transform == Transform::ROTATE_270;
+                const int64_t width   = rotated ? sprite.slice_height : sprite.slice_width;
+                const int64_t height  = rotated ? sprite.slice_width  : sprite.slice_height;
+                const int64_t top     = std::max< int64_t > (sprite.y, 0);
+                const int64_t bottom  = std::min< int64_t > (int64_t(sprite.y) + height, target_height);
+
+                if (top >= bottom || sprite.x >= target_width || int64_t(sprite.x) + width <= 0)
+                {
+                    first = 1; last = 0;
+                }
+                else
+                {
+                    first = int( top        / band_height);
+                    last  = int((bottom - 1) / band_height);
+                }
+            };
+
+            // Se cuentan los sprites de cada franja y después se colocan sus índices en orden:
+
+            band_offsets.assign (size_t(band_count) + 1, 0);
+
+            for (const Sprite & sprite : sprites)
+            {
+                int first, last;
+
+                band_range (sprite, first, last);
+
+                for (int band = first; band <= last; ++band) band_offsets[band + 1]++;
+            }
+
+            for (int band = 0; band < band_count; ++band) band_offsets[band + 1] += band_offsets[band];
+
+            band_sprites.resize (band_offsets[band_count]);
+
+            band_cursors.assign (band_offsets.begin (), band_offsets.end () - 1);
+
+            for (unsigned index = 0, count = unsigned(sprites.size ()); index < count; ++index)
+            {
+                int first, last;
+
+                band_range (sprites[index], first, last);
+
+                for (int band = first; band <= last; ++band) band_sprites[band_cursors[band]++] = index;
+            }
+        }
+
+        template< class COLOR >
+        void Sprite_Batch< COLOR >::draw_sprite (Blitter & blitter, const Sprite & sprite)
+        {
+            switch (sprite.blend_mode)
+            {
+                case Blend_Mode::REPLACE: blit_sprite< argb::blend_replace< Color > > (blitter, sprite); break;
+                case Blend_Mode::HALF:    blit_sprite< argb::blend_half   < Color > > (blitter, sprite); break;
+
+                default:
+
+                    if constexpr (alpha_blending)
+                    {
+                        switch (sprite.blend_mode)
+                        {
+                            case Blend_Mode::SOURCE_OVER:   blit_sprite< argb::blend_source_over  < Color > > (blitter, sprite); break;
+                            case Blend_Mode::PREMULTIPLIED: blit_sprite< argb::blend_premultiplied< Color > > (blitter, sprite); break;
+                            case Blend_Mode::ADDITIVE:      blit_sprite< argb::blend_additive     < Color > > (blitter, sprite); break;
+                            default:                        blit_sprite< argb::blend_multiply     < Color > > (blitter, sprite);
+                        }
+                    }
+            }
+        }
+
+    }
+
+#endif
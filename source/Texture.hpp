@@ -0,0 +1,469 @@
+// Este código es de dominio público.
+
+#ifndef TEXTURE_HEADER
+#define TEXTURE_HEADER
+
+    #include <algorithm>
+    #include <cassert>
+    #include <cmath>
+    #include <cstdint>
+    #include <cstring>
+    #include <type_traits>
+    #include <vector>
+    #include "blend_functions.hpp"
+    #include "Color_Buffer.hpp"
+    #include "simd.hpp"
+
+    namespace example
+    {
+
+        /** Textura para el rasterizer por software. Se construye a partir de un argb::Color_Buffer
+          * y guarda su cadena de mipmaps en bloques de 4x4 texels contiguos (16 texels, que con
+          * los formatos de 32 bits ocupan una línea de caché), de modo que los texels vecinos en
+          * vertical también quedan cerca en memoria y el acceso no depende de cómo esté girado el
+          * triángulo respecto a la textura.
+          *
+          * Las coordenadas (u, v) se repiten en ambos ejes; v = 0 corresponde a la primera fila
+          * del color buffer original.
+          */
+        template< class COLOR >
+        class Texture
+        {
+        public:
+
+            typedef COLOR                        Color;
+            typedef argb::Color_Buffer< Color >  Color_Buffer;
+
+            enum class Filter
+            {
+                NEAREST,
+                BILINEAR
+            };
+
+            static constexpr int block_size = 4;
+
+        private:
+
+            struct Level
+            {
+                int    width;
+                int    height;
+                int    blocks_per_row;
+                size_t offset;                          // Primer texel del nivel en texels
+            };
+
+            // Los formatos de 3 o 4 bytes con componentes de 8 bits se filtran con SIMD leyendo cada
+            // texel con una carga de 32 bits. Con los de 3 bytes la última lee un byte más allá del
+            // último texel, así que se reserva un texel de relleno al final:
+
+            static constexpr bool byte_filter = std::is_same< typename Color::Component_Type, uint8_t >::value
+                                             && (sizeof(Color) == 3 || sizeof(Color) == 4);
+
+            // Interpolación de cuatro texels con pesos fx y fy en [0, 256]. La variante de los
+            // formatos de bytes se elige al construir la textura según argb::get_cpu_tier():
+
+            typedef Color (* Byte_Filter) (const Color * , const Color * , const Color * , const Color * , int fx, int fy);
+
+        private:
+
+            std::vector< Level > levels;
+            std::vector< Color > texels;
+            Filter               filter;
+            Byte_Filter          filter_bytes;
+
+        public:
+
+            /** Copia image en el formato por bloques y, si se pide, genera los mipmaps promediando
+              * cada 2x2 texels del nivel anterior hasta llegar a 1x1.
+              */
+            Texture(const Color_Buffer & image, bool mipmaps = true, Filter filter = Filter::BILINEAR);
+
+        public:
+
+            unsigned get_width       () const { return unsigned(levels[0].width ); }
+            unsigned get_height      () const { return unsigned(levels[0].height); }
+            unsigned get_level_count () const { return unsigned(levels.size ()); }
+
+            void set_filter (Filter new_filter)
+            {
+                filter = new_filter;
+            }
+
+            Filter get_filter () const
+            {
+                return filter;
+            }
+
+            const Color & get_texel (unsigned level, int x, int y) const
+            {
+                assert(level < levels.size () && x >= 0 && x < levels[level].width && y >= 0 && y < levels[level].height);
+
+                return texels[texel_index (levels[level], x, y)];
+            }
+
+            /** Nivel de mipmap que corresponde a rho_squared, el mayor cuadrado de la longitud de
+              * las derivadas de (u * width, v * height) en pantalla. El nivel es el log2 de rho
+              * redondeado, que se obtiene del exponente del float sin calcular el logaritmo.
+              */
+            unsigned select_level (float rho_squared) const
+            {
+                if (!(rho_squared > 1.f)) return 0;
+
+                uint32_t bits;
+
+                std::memcpy (&bits, &rho_squared, sizeof(bits));
+
+                int level = ((int(bits >> 23) & 0xFF) - 127 + 1) >> 1;
+
+                return unsigned(std::min (level, int(levels.size ()) - 1));
+            }
+
+            Color sample (float u, float v, unsigned level = 0) const
+            {
+                assert(level < levels.size ());
+
+                if (filter == Filter::NEAREST)
+                    return sample_nearest  (levels[level], u, v);
+                else
+                    return sample_bilinear (levels[level], u, v);
+            }
+
+        private:
+
+            static size_t texel_index (const Level & level, int x, int y)
+            {
+                return level.offset
+                     + size_t((y >> 2) * level.blocks_per_row + (x >> 2)) * (block_size * block_size)
+                     + size_t(((y & 3) << 2) | (x & 3));
+            }
+
+            // Lleva una coordenada de texel a [0, size). Las no finitas o desmesuradas (que solo
+            // aparecen en los bordes de los polígonos por redondeo) se llevan a 0:
+
+            static int wrap (float texel, int size)
+            {
+                if (!(std::abs (texel) < 16777216.f)) return 0;
+
+                int index = int(texel) % size;
+
+                return index < 0 ? index + size : index;
+            }
+
+            Color sample_nearest (const Level & level, float u, float v) const
+            {
+                int x = wrap (std::floor (u * float(level.width )), level.width );
+                int y = wrap (std::floor (v * float(level.height)), level.height);
+
+                return texels[texel_index (level, x, y)];
+            }
+
+            Color sample_bilinear (const Level & level, float u, float v) const;
+
+            static Color filter_bytes_scalar (const Color * t00, const Color * t10, const Color * t01, const Color * t11, int fx, int fy);
+
+            #if defined(SIMD_SSE2_AVAILABLE)
+
+                static Color filter_gathered    (__m128i gathered, int fx, int fy);
+
+                static Color filter_bytes_sse2  (const Color * t00, const Color * t10, const Color * t01, const Color * t11, int fx, int fy);
+
+            #endif
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                ARGB_AVX2_TARGET
+                static Color filter_bytes_avx2  (const Color * t00, const Color * t10, const Color * t01, const Color * t11, int fx, int fy);
+
+            #endif
+
+            static Color filter_generic (const Color & t00, const Color & t10, const Color & t01, const Color & t11, int fx, int fy);
+
+        };
+
+        template< class COLOR >
+        Texture< COLOR >::Texture(const Color_Buffer & image, bool mipmaps, Filter filter)
+        :
+            filter      (filter),
+            filter_bytes(nullptr)
+        {
+            assert(image.get_width () > 0 && image.get_height () > 0);
+
+            if constexpr (byte_filter)
+            {
+                Byte_Filter sse2 = nullptr;
+                Byte_Filter avx2 = nullptr;
+
+                #if defined(SIMD_SSE2_AVAILABLE)
+                    sse2 = &filter_bytes_sse2;
+                #endif
+
+                #if defined(SIMD_AVX2_DISPATCH)
+                    avx2 = &filter_bytes_avx2;
+                #endif
+
+                filter_bytes = argb::select_by_cpu_tier< Byte_Filter > (&filter_bytes_scalar, sse2, avx2);
+            }
+
+            // Tamaño y posición de cada nivel:
+
+            size_t total  = 0;
+            int    width  = int(image.get_width  ());
+            int    height = int(image.get_height ());
+
+            while (true)
+            {
+                Level level;
+
+                level.width          = width;
+                level.height         = height;
+                level.blocks_per_row = (width + block_size - 1) / block_size;
+                level.offset         = total;
+
+                levels.push_back (level);
+
+                total += size_t(level.blocks_per_row) * ((height + block_size - 1) / block_size) * (block_size * block_size);
+
+                if (!mipmaps || (width == 1 && height == 1)) break;
+
+                width  = std::max (width  / 2, 1);
+                height = std::max (height / 2, 1);
+            }
+
+            texels.resize (total + (byte_filter ? 1 : 0));
+
+            // El nivel 0 se copia tal cual:
+
+            for (int y = 0; y < levels[0].height; ++y)
+            {
+                const Color * source = image.row (unsigned(y));
+
+                for (int x = 0; x < levels[0].width; ++x)
+                {
+                    texels[texel_index (levels[0], x, y)] = source[x];
+                }
+            }
+
+            // Cada nivel siguiente promedia 2x2 texels del anterior. Si el anterior tiene un tamaño
+            // impar, la última columna o fila se repite:
+
+            for (size_t index = 1; index < levels.size (); ++index)
+            {
+                const Level & parent = levels[index - 1];
+                const Level & level  = levels[index];
+
+                for (int y = 0; y < level.height; ++y)
+                {
+                    int y0 = std::min (2 * y, parent.height - 1), y1 = std::min (2 * y + 1, parent.height - 1);
+
+                    for (int x = 0; x < level.width; ++x)
+                    {
+                        int x0 = std::min (2 * x, parent.width - 1), x1 = std::min (2 * x + 1, parent.width - 1);
+
+                        Color top    = texels[texel_index (parent, x0, y0)];
+                        Color bottom = texels[texel_index (parent, x0, y1)];
+
+                        argb::blend_half (top,    texels[texel_index (parent, x1, y0)]);
+                        argb::blend_half (bottom, texels[texel_index (parent, x1, y1)]);
+                        argb::blend_half (top,    bottom);
+
+                        texels[texel_index (level, x, y)] = top;
+                    }
+                }
+            }
+        }
+
+        template< class COLOR >
+        typename Texture< COLOR >::Color Texture< COLOR >::sample_bilinear (const Level & level, float u, float v) const
+        {
+            // Los centros de los texels están en (i + 0.5) / size. Los pesos se redondean a 1/256:
+
+            float tx = u * float(level.width ) - 0.5f;
+            float ty = v * float(level.height) - 0.5f;
+            float fx = std::floor (tx);
+            float fy = std::floor (ty);
+
+            int x0 = wrap (fx, level.width ), x1 = x0 + 1 == level.width  ? 0 : x0 + 1;
+            int y0 = wrap (fy, level.height), y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+            int wx = std::isfinite (tx) ? int((tx - fx) * 256.f) : 0;
+            int wy = std::isfinite (ty) ? int((ty - fy) * 256.f) : 0;
+
+            const Color * t00 = texels.data () + texel_index (level, x0, y0);
+            const Color * t10 = texels.data () + texel_index (level, x1, y0);
+            const Color * t01 = texels.data () + texel_index (level, x0, y1);
+            const Color * t11 = texels.data () + texel_index (level, x1, y1);
+
+            if constexpr (byte_filter)
+                return filter_bytes (t00, t10, t01, t11, wx, wy);
+            else
+                return filter_generic (*t00, *t10, *t01, *t11, wx, wy);
+        }
+
+        template< class COLOR >
+        typename Texture< COLOR >::Color Texture< COLOR >::filter_bytes_scalar
+        (
+            const Color * t00,
+            const Color * t10,
+            const Color * t01,
+            const Color * t11,
+            int           fx,
+            int           fy
+        )
+        {
+            // Se interpola primero en horizontal y luego en vertical con enteros de 16 bits, lo que
+            // no desborda porque 255 * 256 cabe. Las variantes SIMD dan el mismo resultado:
+
+            const uint8_t * b00 = reinterpret_cast< const uint8_t * >(t00);
+            const uint8_t * b10 = reinterpret_cast< const uint8_t * >(t10);
+            const uint8_t * b01 = reinterpret_cast< const uint8_t * >(t01);
+            const uint8_t * b11 = reinterpret_cast< const uint8_t * >(t11);
+
+            uint8_t result[sizeof(Color)];
+
+            for (size_t i = 0; i < sizeof(Color); ++i)
+            {
+                unsigned row_top    = (b00[i] * unsigned(256 - fx) + b10[i] * unsigned(fx)) >> 8;
+                unsigned row_bottom = (b01[i] * unsigned(256 - fx) + b11[i] * unsigned(fx)) >> 8;
+
+                result[i] = uint8_t((row_top * unsigned(256 - fy) + row_bottom * unsigned(fy)) >> 8);
+            }
+
+            Color color;
+
+            std::memcpy (&color, result, sizeof(Color));
+
+            return color;
+        }
+
+        #if defined(SIMD_SSE2_AVAILABLE)
+
+            template< class COLOR >
+            typename Texture< COLOR >::Color Texture< COLOR >::filter_gathered (__m128i gathered, int fx, int fy)
+            {
+                // gathered contiene t00, t10, t01 y t11. Se expanden a 16 bits como [t00 | t10] y
+                // [t01 | t11]:
+
+                const __m128i zero     = _mm_setzero_si128 ();
+                const __m128i top      = _mm_unpacklo_epi8 (gathered, zero);
+                const __m128i bottom   = _mm_unpackhi_epi8 (gathered, zero);
+                const __m128i weight_x = _mm_setr_epi16 (short(256 - fx), short(256 - fx), short(256 - fx), short(256 - fx), short(fx), short(fx), short(fx), short(fx));
+
+                __m128i row_top    = _mm_mullo_epi16 (top,    weight_x);
+                __m128i row_bottom = _mm_mullo_epi16 (bottom, weight_x);
+
+                row_top    = _mm_srli_epi16 (_mm_add_epi16 (row_top,    _mm_srli_si128 (row_top,    8)), 8);
+                row_bottom = _mm_srli_epi16 (_mm_add_epi16 (row_bottom, _mm_srli_si128 (row_bottom, 8)), 8);
+
+                __m128i blended = _mm_add_epi16
+                (
+                    _mm_mullo_epi16 (row_top,    _mm_set1_epi16 (short(256 - fy))),
+                    _mm_mullo_epi16 (row_bottom, _mm_set1_epi16 (short(fy)))
+                );
+
+                blended = _mm_packus_epi16 (_mm_srli_epi16 (blended, 8), zero);
+
+                int32_t packed = _mm_cvtsi128_si32 (blended);
+                Color   color;
+
+                std::memcpy (&color, &packed, sizeof(Color));
+
+                return color;
+            }
+
+            template< class COLOR >
+            typename Texture< COLOR >::Color Texture< COLOR >::filter_bytes_sse2
+            (
+                const Color * t00,
+                const Color * t10,
+                const Color * t01,
+                const Color * t11,
+                int           fx,
+                int           fy
+            )
+            {
+                int32_t values[4];
+
+                std::memcpy (values + 0, t00, 4);
+                std::memcpy (values + 1, t10, 4);
+                std::memcpy (values + 2, t01, 4);
+                std::memcpy (values + 3, t11, 4);
+
+                return filter_gathered (_mm_loadu_si128 (reinterpret_cast< const __m128i * >(values)), fx, fy);
+            }
+
+        #endif
+
+        #if defined(SIMD_AVX2_DISPATCH)
+
+            template< class COLOR >
+            ARGB_AVX2_TARGET
+            typename Texture< COLOR >::Color Texture< COLOR >::filter_bytes_avx2
+            (
+                const Color * t00,
+                const Color * t10,
+                const Color * t01,
+                const Color * t11,
+                int           fx,
+                int           fy
+            )
+            {
+                // Los cuatro texels se reúnen con una única instrucción de gather:
+
+                const uint8_t * base    = reinterpret_cast< const uint8_t * >(t00);
+                const __m128i   offsets = _mm_setr_epi32
+                (
+                    0,
+                    int(reinterpret_cast< const uint8_t * >(t10) - base),
+                    int(reinterpret_cast< const uint8_t * >(t01) - base),
+                    int(reinterpret_cast< const uint8_t * >(t11) - base)
+                );
+
+                return filter_gathered (_mm_i32gather_epi32 (reinterpret_cast< const int * >(base), offsets, 1), fx, fy);
+            }
+
+        #endif
+
+        template< class COLOR >
+        typename Texture< COLOR >::Color Texture< COLOR >::filter_generic
+        (
+            const Color & t00,
+            const Color & t10,
+            const Color & t01,
+            const Color & t11,
+            int           fx,
+            int           fy
+        )
+        {
+            typedef typename Color::Component_Type Component;
+
+            // Los formatos empaquetados no se filtran:
+
+            if constexpr (std::is_void< Component >::value)
+            {
+                return (fx < 128 ? (fy < 128 ? t00 : t01) : (fy < 128 ? t10 : t11));
+            }
+            else
+            {
+                const float wx = float(fx) / 256.f;
+                const float wy = float(fy) / 256.f;
+
+                Color result;
+
+                for (unsigned i = 0; i < Color::component_count; ++i)
+                {
+                    float top    = float(t00.components[i]) + (float(t10.components[i]) - float(t00.components[i])) * wx;
+                    float bottom = float(t01.components[i]) + (float(t11.components[i]) - float(t01.components[i])) * wx;
+                    float value  = top + (bottom - top) * wy;
+
+                    if constexpr (std::is_floating_point< Component >::value)
+                        result.components[i] = Component(value);
+                    else
+                        result.components[i] = Component(value + 0.5f);
+                }
+
+                return result;
+            }
+        }
+
+    }
+
+#endif
@@ -0,0 +1,147 @@
+// Este código es de dominio público.
+
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+    #include <algorithm>
+    #include <atomic>
+    #include <condition_variable>
+    #include <functional>
+    #include <mutex>
+    #include <thread>
+    #include <vector>
+
+    namespace example
+    {
+
+        /** Conjunto de hilos persistentes que reparten entre sí una lista de tareas numeradas.
+          * El hilo que llama a run() participa como el worker 0, por lo que con un único worker
+          * no se crea ningún hilo adicional.
+          */
+        class Thread_Pool
+        {
+        public:
+
+            typedef std::function< void (unsigned worker_index, unsigned task_index) > Task;
+
+        private:
+
+            std::vector< std::thread > threads;
+
+            std::mutex                 mutex;
+            std::condition_variable    work_available;
+            std::condition_variable    work_finished;
+
+            const Task               * task;
+            unsigned                   task_count;
+            std::atomic< unsigned >    next_task;
+            unsigned                   busy_workers;
+            unsigned                   generation;
+            bool                       exiting;
+
+        public:
+
+            Thread_Pool(unsigned worker_count = std::thread::hardware_concurrency ())
+            :
+                task        (nullptr),
+                task_count  (0),
+                next_task   (0),
+                busy_workers(0),
+                generation  (0),
+                exiting     (false)
+            {
+                worker_count = std::max (worker_count, 1u);
+
+                for (unsigned index = 1; index < worker_count; ++index)
+                {
+                    threads.emplace_back (&Thread_Pool::worker_loop, this, index);
+                }
+            }
+
+           ~Thread_Pool()
+            {
+                {
+                    std::lock_guard< std::mutex > lock(mutex);
+                    exiting = true;
+                }
+
+                work_available.notify_all ();
+
+                for (auto & thread : threads) thread.join ();
+            }
+
+            Thread_Pool(const Thread_Pool & ) = delete;
+            Thread_Pool & operator = (const Thread_Pool & ) = delete;
+
+        public:
+
+            unsigned get_worker_count () const
+            {
+                return unsigned(threads.size ()) + 1;
+            }
+
+            /** Ejecuta task(worker, índice) para cada índice en [0, count) y no retorna hasta
+              * que todas las tareas han terminado. Las tareas se reparten dinámicamente.
+              */
+            void run (unsigned count, const Task & given_task)
+            {
+                {
+                    std::lock_guard< std::mutex > lock(mutex);
+
+                    task         = &given_task;
+                    task_count   = count;
+                    next_task    = 0;
+                    busy_workers = unsigned(threads.size ());
+                    generation++;
+                }
+
+                work_available.notify_all ();
+
+                consume_tasks (0);
+
+                std::unique_lock< std::mutex > lock(mutex);
+
+                work_finished.wait (lock, [this] () { return busy_workers == 0; });
+
+                task = nullptr;
+            }
+
+        private:
+
+            void consume_tasks (unsigned worker_index)
+            {
+                for (unsigned index; (index = next_task++) < task_count; )
+                {
+                    (*task) (worker_index, index);
+                }
+            }
+
+            void worker_loop (unsigned worker_index)
+            {
+                unsigned last_generation = 0;
+
+                while (true)
+                {
+                    {
+                        std::unique_lock< std::mutex > lock(mutex);
+
+                        work_available.wait (lock, [&] () { return exiting || generation != last_generation; });
+
+                        if (exiting) return;
+
+                        last_generation = generation;
+                    }
+
+                    consume_tasks (worker_index);
+
+                    std::lock_guard< std::mutex > lock(mutex);
+
+                    if (--busy_workers == 0) work_finished.notify_one ();
+                }
+            }
+
+        };
+
+    }
+
+#endif
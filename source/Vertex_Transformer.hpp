@@ -0,0 +1,374 @@
+// Este código es de dominio público.
+
+#ifndef VERTEX_TRANSFORMER_HEADER
+#define VERTEX_TRANSFORMER_HEADER
+
+    #include <algorithm>
+    #include <cstddef>
+    #include <cstdint>
+    #include <vector>
+    #include "math.hpp"
+    #include "MeshData.h"
+    #include "simd.hpp"
+    #include "Thread_Pool.hpp"
+
+    namespace example
+    {
+
+        /** Transforma por lotes los vértices y normales de un MeshData. Guarda una copia de las
+          * posiciones y normales originales como estructura de arrays (una componente por array)
+          * para que cada instrucción SIMD procese 8 vértices. En una sola pasada se generan
+          * transformed_vertices (coordenadas de clip), transformed_normals y display_vertices
+          * (con la misma conversión a pantalla que usa Clipper).
+          */
+        class Vertex_Transformer
+        {
+        public:
+
+            // Número de vértices de cada tarea cuando se reparte el trabajo entre hilos. Las mallas
+            // con menos de dos bloques se transforman en el hilo que llama:
+
+            static constexpr size_t parallel_block_size = 4096;
+
+        private:
+
+            // Componentes de las posiciones y normales originales. Los arrays se rellenan hasta
+            // un múltiplo de 8 para que el último bloque se pueda leer completo:
+
+            std::vector< float > x,  y,  z,  w;
+            std::vector< float > nx, ny, nz;
+
+            size_t vertex_count;
+            size_t normal_count;
+
+        public:
+
+            Vertex_Transformer()
+            :
+                vertex_count(0),
+                normal_count(0)
+            {
+            }
+
+            Vertex_Transformer(const MeshData & mesh)
+            {
+                load (mesh);
+            }
+
+            /** Copia las posiciones y normales originales de la malla. Solo hace falta volver a
+              * llamarla si estas cambian.
+              */
+            void load (const MeshData & mesh);
+
+            /** Escribe en la malla sus vértices y normales transformados y sus vértices de pantalla.
+              * transformation lleva los vértices a coordenadas de clip (proyección * vista * modelo)
+              * y normal_transformation es la matriz con la que se transforman las normales.
+              */
+            void transform
+            (
+                MeshData        & mesh,
+                const Matrix44  & transformation,
+                const Matrix33  & normal_transformation,
+                unsigned          viewport_width,
+                unsigned          viewport_height,
+                Thread_Pool     * thread_pool = nullptr
+            )
+            const;
+
+        private:
+
+            // Transforma los vértices y normales de [begin, end) con los vectores de un nivel de
+            // argb::Cpu_Tier (uno de los simd::*_Tier). Cada nivel compilado tiene su instancia y
+            // transform() elige la que admite la CPU:
+
+            typedef void (Vertex_Transformer::*Block_Kernel)
+            (
+                MeshData        & mesh,
+                const Matrix44  & transformation,
+                const Matrix33  & normal_transformation,
+                float             half_width,
+                float             half_height,
+                size_t            begin,
+                size_t            end
+            )
+            const;
+
+            template< class SIMD_TIER >
+            void transform_block
+            (
+                MeshData        & mesh,
+                const Matrix44  & transformation,
+                const Matrix33  & normal_transformation,
+                float             half_width,
+                float             half_height,
+                size_t            begin,
+                size_t            end
+            )
+            const
+            {
+                transform_vertices< typename SIMD_TIER::Float32x8 > (mesh, transformation, half_width, half_height, begin, std::min (end, vertex_count));
+                transform_normals < typename SIMD_TIER::Float32x8 > (mesh, normal_transformation,                   begin, std::min (end, normal_count));
+            }
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                // Entrada del kernel AVX2, que se compila para AVX2 con todo el código al que llama
+                // integrado (ver ARGB_AVX2_KERNEL en cpu_dispatch.hpp):
+
+                ARGB_AVX2_KERNEL void transform_block_avx2
+                (
+                    MeshData        & mesh,
+                    const Matrix44  & transformation,
+                    const Matrix33  & normal_transformation,
+                    float             half_width,
+                    float             half_height,
+                    size_t            begin,
+                    size_t            end
+                )
+                const
+                {
+                    transform_block< simd::Avx2_Tier > (mesh, transformation, normal_transformation, half_width, half_height, begin, end);
+                }
+
+            #endif
+
+            Block_Kernel select_block_kernel () const;
+
+            template< class FLOAT32X8 >
+            void transform_vertices
+            (
+                MeshData        & mesh,
+                const Matrix44  & transformation,
+                float             half_width,
+                float             half_height,
+                size_t            begin,
+                size_t            end
+            )
+            const;
+
+            template< class FLOAT32X8 >
+            void transform_normals
+            (
+                MeshData        & mesh,
+                const Matrix33  & transformation,
+                size_t            begin,
+                size_t            end
+            )
+            const;
+
+        };
+
+        inline void Vertex_Transformer::load (const MeshData & mesh)
+        {
+            vertex_count = mesh.original_vertices.size ();
+            normal_count = mesh.original_normals .size ();
+
+            size_t padded_vertex_count = (vertex_count + 7) & ~size_t(7);
+            size_t padded_normal_count = (normal_count + 7) & ~size_t(7);
+
+            x.assign (padded_vertex_count, 0.f);
+            y.assign (padded_vertex_count, 0.f);
+            z.assign (padded_vertex_count, 0.f);
+            w.assign (padded_vertex_count, 1.f);
+
+            for (size_t index = 0; index < vertex_count; ++index)
+            {
+                const Vertex & vertex = mesh.original_vertices[index];
+
+                x[index] = vertex.x;
+                y[index] = vertex.y;
+                z[index] = vertex.z;
+                w[index] = vertex.w;
+            }
+
+            nx.assign (padded_normal_count, 0.f);
+            ny.assign (padded_normal_count, 0.f);
+            nz.assign (padded_normal_count, 0.f);
+
+            for (size_t index = 0; index < normal_count; ++index)
+            {
+                const Vector3f & normal = mesh.original_normals[index];
+
+                nx[index] = normal.x;
+                ny[index] = normal.y;
+                nz[index] = normal.z;
+            }
+        }
+
+        inline void Vertex_Transformer::transform
+        (
+            MeshData        & mesh,
+            const Matrix44  & transformation,
+            const Matrix33  & normal_transformation,
+            unsigned          viewport_width,
+            unsigned          viewport_height,
+            Thread_Pool     * thread_pool
+        )
+        const
+        {
+            const float half_width  = float(viewport_width ) * 0.5f;
+            const float half_height = float(viewport_height) * 0.5f;
+
+            // Los buffers de salida se dimensionan antes de repartir el trabajo para que cada
+            // tarea solo escriba en su propio rango:
+
+            mesh.transformed_vertices.resize (vertex_count);
+            mesh.display_vertices    .resize (vertex_count);
+            mesh.transformed_normals .resize (normal_count);
+
+            const size_t       count  = std::max (vertex_count, normal_count);
+            const Block_Kernel kernel = select_block_kernel ();
+
+            auto transform_block = [&] (size_t begin, size_t end)
+            {
+                (this->*kernel) (mesh, transformation, normal_transformation, half_width, half_height, begin, end);
+            };
+
+            if (thread_pool && count >= 2 * parallel_block_size)
+            {
+                unsigned block_count = unsigned((count + parallel_block_size - 1) / parallel_block_size);
+
+                thread_pool->run
+                (
+                    block_count,
+                    [&] (unsigned , unsigned block)
+                    {
+                        transform_block (block * parallel_block_size, (block + 1) * parallel_block_size);
+                    }
+                );
+            }
+            else
+                transform_block (0, count);
+        }
+
+        inline Vertex_Transformer::Block_Kernel Vertex_Transformer::select_block_kernel () const
+        {
+            // Las variantes que no se han compilado quedan a nullptr y se usa la del nivel inferior.
+            // AVX-512 usa la de AVX2, ya que los kernels trabajan con vectores de 8 carriles:
+
+            Block_Kernel sse2 = nullptr;
+            Block_Kernel avx2 = nullptr;
+
+            #if defined(SIMD_SSE2_AVAILABLE)
+                sse2 = &Vertex_Transformer::transform_block< simd::Sse2_Tier >;
+            #endif
+
+            #if defined(SIMD_AVX2_DISPATCH)
+                avx2 = &Vertex_Transformer::transform_block_avx2;
+            #endif
+
+            return argb::select_by_cpu_tier< Block_Kernel > (&Vertex_Transformer::transform_block< simd::Scalar_Tier >, sse2, avx2);
+        }
+
+        template< class FLOAT32X8 >
+        void Vertex_Transformer::transform_vertices
+        (
+            MeshData        & mesh,
+            const Matrix44  & m,
+            float             half_width,
+            float             half_height,
+            size_t            begin,
+            size_t            end
+        )
+        const
+        {
+            // Las matrices de glm se indexan como m[columna][fila]:
+
+            const FLOAT32X8 m00 = FLOAT32X8::set1 (m[0][0]), m01 = FLOAT32X8::set1 (m[1][0]), m02 = FLOAT32X8::set1 (m[2][0]), m03 = FLOAT32X8::set1 (m[3][0]);
+            const FLOAT32X8 m10 = FLOAT32X8::set1 (m[0][1]), m11 = FLOAT32X8::set1 (m[1][1]), m12 = FLOAT32X8::set1 (m[2][1]), m13 = FLOAT32X8::set1 (m[3][1]);
+            const FLOAT32X8 m20 = FLOAT32X8::set1 (m[0][2]), m21 = FLOAT32X8::set1 (m[1][2]), m22 = FLOAT32X8::set1 (m[2][2]), m23 = FLOAT32X8::set1 (m[3][2]);
+            const FLOAT32X8 m30 = FLOAT32X8::set1 (m[0][3]), m31 = FLOAT32X8::set1 (m[1][3]), m32 = FLOAT32X8::set1 (m[2][3]), m33 = FLOAT32X8::set1 (m[3][3]);
+
+            const FLOAT32X8 one      = FLOAT32X8::set1 (1.f);
+            const FLOAT32X8 scale_x  = FLOAT32X8::set1 (half_width );
+            const FLOAT32X8 scale_y  = FLOAT32X8::set1 (half_height);
+            const FLOAT32X8 scale_z  = FLOAT32X8::set1 (depth_scale);
+
+            // Los vértices que quedan detrás de la cámara (w <= 0) no tienen una proyección
+            // válida. Sus coordenadas de pantalla se acotan para que la conversión a entero no
+            // desborde; el recorte posterior descarta o sustituye esos vértices:
+
+            const FLOAT32X8 lower    = FLOAT32X8::set1 (-1073741824.f);
+            const FLOAT32X8 upper    = FLOAT32X8::set1 ( 1073741824.f);
+
+            for (size_t index = begin; index < end; index += 8)
+            {
+                const FLOAT32X8 vx = FLOAT32X8::load (x.data () + index);
+                const FLOAT32X8 vy = FLOAT32X8::load (y.data () + index);
+                const FLOAT32X8 vz = FLOAT32X8::load (z.data () + index);
+                const FLOAT32X8 vw = FLOAT32X8::load (w.data () + index);
+
+                const FLOAT32X8 cx = m00 * vx + m01 * vy + m02 * vz + m03 * vw;
+                const FLOAT32X8 cy = m10 * vx + m11 * vy + m12 * vz + m13 * vw;
+                const FLOAT32X8 cz = m20 * vx + m21 * vy + m22 * vz + m23 * vw;
+                const FLOAT32X8 cw = m30 * vx + m31 * vy + m32 * vz + m33 * vw;
+
+                const FLOAT32X8 inverse_w = one / cw;
+
+                const FLOAT32X8 sx = FLOAT32X8::max (FLOAT32X8::min (cx * inverse_w * scale_x + scale_x, upper), lower);
+                const FLOAT32X8 sy = FLOAT32X8::max (FLOAT32X8::min (cy * inverse_w * scale_y + scale_y, upper), lower);
+                const FLOAT32X8 sz = FLOAT32X8::max (FLOAT32X8::min (cz * inverse_w * scale_z,           upper), lower);
+
+                // Se vuelve al formato AoS de MeshData:
+
+                float   clip   [4][8];
+                int32_t display[3][8];
+
+                cx.store (clip[0]);
+                cy.store (clip[1]);
+                cz.store (clip[2]);
+                cw.store (clip[3]);
+
+                sx.to_int32 ().store (display[0]);
+                sy.to_int32 ().store (display[1]);
+                sz.to_int32 ().store (display[2]);
+
+                Point4f * transformed = mesh.transformed_vertices.data () + index;
+                Point4i * projected   = mesh.display_vertices    .data () + index;
+
+                for (size_t lane = 0, lanes = std::min (end - index, size_t(8)); lane < lanes; ++lane)
+                {
+                    transformed[lane] = Point4f(clip   [0][lane], clip   [1][lane], clip   [2][lane], clip[3][lane]);
+                    projected  [lane] = Point4i(display[0][lane], display[1][lane], display[2][lane], 1);
+                }
+            }
+        }
+
+        template< class FLOAT32X8 >
+        void Vertex_Transformer::transform_normals
+        (
+            MeshData        & mesh,
+            const Matrix33  & m,
+            size_t            begin,
+            size_t            end
+        )
+        const
+        {
+            const FLOAT32X8 m00 = FLOAT32X8::set1 (m[0][0]), m01 = FLOAT32X8::set1 (m[1][0]), m02 = FLOAT32X8::set1 (m[2][0]);
+            const FLOAT32X8 m10 = FLOAT32X8::set1 (m[0][1]), m11 = FLOAT32X8::set1 (m[1][1]), m12 = FLOAT32X8::set1 (m[2][1]);
+            const FLOAT32X8 m20 = FLOAT32X8::set1 (m[0][2]), m21 = FLOAT32X8::set1 (m[1][2]), m22 = FLOAT32X8::set1 (m[2][2]);
+
+            for (size_t index = begin; index < end; index += 8)
+            {
+                const FLOAT32X8 vx = FLOAT32X8::load (nx.data () + index);
+                const FLOAT32X8 vy = FLOAT32X8::load (ny.data () + index);
+                const FLOAT32X8 vz = FLOAT32X8::load (nz.data () + index);
+
+                float normal[3][8];
+
+                (m00 * vx + m01 * vy + m02 * vz).store (normal[0]);
+                (m10 * vx + m11 * vy + m12 * vz).store (normal[1]);
+                (m20 * vx + m21 * vy + m22 * vz).store (normal[2]);
+
+                Vector3f * transformed = mesh.transformed_normals.data () + index;
+
+                for (size_t lane = 0, lanes = std::min (end - index, size_t(8)); lane < lanes; ++lane)
+                {
+                    transformed[lane] = Vector3f(normal[0][lane], normal[1][lane], normal[2][lane]);
+                }
+            }
+        }
+
+    }
+
+#endif
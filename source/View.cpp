@@ -115,6 +115,7 @@ namespace example
         bunnyNodeTexture->scale(vec3(0.25f)); // Scale the bunny down further.
         bunnyNodeTexture->rotate(90.0f, vec3(0.0f, 1.0f, 0.0f)); // Rotate the bunny.
         bunnyNodeTexture->translate(vec3(4.0f, 0.0f, 0.0f)); // Move the bunny further to the right.
+        bunnyNodeTexture->occluder = true; // The textured bunny is drawn opaque, so it hides what is behind it.
 
 
         // Se establece la configuración básica:
@@ -163,6 +164,7 @@ namespace example
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         beginRender();
         renderSkybox();
+        buildOcclusionBuffer();
         renderOpaqueObjects();
         renderTransparentObjects();  
         if (post_processing_enabled)
@@ -192,6 +194,15 @@ namespace example
     {
         skybox.render(camera);
     }
+    void View::buildOcclusionBuffer()
+    {
+        // The occluders are rasterized on the CPU so that hidden nodes skip their draw calls.
+        // The only opaque mesh is the textured bunny, which renderOpaqueObjects() draws with the
+        // camera matrix alone, so its occluder is collected with that same matrix:
+        occlusion_culler.begin_frame(camera.get_projection_matrix());
+        bunnyNodeTexture->collect_occluders(occlusion_culler, camera.get_model_view_matrix());
+        occlusion_culler.build(&thread_pool);
+    }
     void View::renderOpaqueObjects()
     {
         glDisable(GL_BLEND);
@@ -207,7 +218,7 @@ namespace example
 
         GLuint textureBunnyId = textureManager.getTexture("textureBunny");
 
-        bunnyNodeTexture->render(model_view_matrix_id, camera_view_matrix, textureBunnyId);
+        bunnyNodeTexture->render(model_view_matrix_id, camera_view_matrix, textureBunnyId, &occlusion_culler);
     }
 
 
@@ -229,7 +240,7 @@ namespace example
         glm::mat4 projection_matrix = camera.get_projection_matrix();
         glUniformMatrix4fv(projection_matrix_id, 1, GL_FALSE, glm::value_ptr(projection_matrix));
 
-        rootNode->render(model_view_matrix_id, camera_view_matrix);
+        rootNode->render(model_view_matrix_id, camera_view_matrix, &occlusion_culler);
     }
 
 
@@ -16,6 +16,8 @@
 #include "FrameBuffer.h"
 #include "PostProcess.h"
 #include "MeshDataTypes.h"
+#include "Occlusion_Culler.hpp"
+#include "Thread_Pool.hpp"
 
 namespace example
 {
@@ -42,6 +44,8 @@ namespace example
         int    last_pointer_x;
         int    last_pointer_y;
         TextureManager textureManager;
+        Occlusion_Culler occlusion_culler;
+        Thread_Pool thread_pool;
         static const std::string   vertex_shader_code;
         static const std::string fragment_shader_code;  
         static const std::string   vertex_shader_code_texture;
@@ -52,6 +56,7 @@ namespace example
         float   angle;
         void beginRender();
         void renderSkybox();
+        void buildOcclusionBuffer();
         void renderOpaqueObjects();
         void renderTransparentObjects();
         void endRender();
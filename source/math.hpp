@@ -38,6 +38,12 @@
         typedef glm::fvec3 Point3f;
         typedef glm::fvec4 Point4f;
 
+        // Factor con el que se escala la z normalizada de los vértices de pantalla (Point4i) para
+        // convertirla en entero. Lo usan la proyección (Clipper, Vertex_Transformer) y los formatos
+        // del z-buffer (Depth_Formats.hpp):
+
+        constexpr float depth_scale = 100000000.f;
+
         template< class CLASS >
         inline const float * get_values (const CLASS & object)
         {
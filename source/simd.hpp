@@ -0,0 +1,717 @@
+// Este código es de dominio público.
+
+#ifndef SIMD_HEADER
+#define SIMD_HEADER
+
+    #include <cmath>
+    #include <cstddef>
+    #include <cstdint>
+    #include <cstring>
+    #include "cpu_dispatch.hpp"
+
+    // La detección de SSE2 (y la inclusión de sus cabeceras) la hace cpu_dispatch.hpp:
+
+    #if defined(ARGB_SSE2_AVAILABLE)
+        #define SIMD_SSE2_AVAILABLE
+    #endif
+
+    // SIMD_AVX2_AVAILABLE indica que todo el programa se compila para AVX2. SIMD_AVX2_DISPATCH,
+    // que los vectores AVX2 existen y se pueden usar en los kernels que se eligen en tiempo de
+    // ejecución con argb::select_by_cpu_tier():
+
+    #if defined(__AVX2__)
+        #define SIMD_AVX2_AVAILABLE
+        #include <immintrin.h>
+    #endif
+
+    #if defined(SIMD_AVX2_AVAILABLE) || (defined(SIMD_SSE2_AVAILABLE) && defined(ARGB_AVX2_DISPATCH))
+        #define SIMD_AVX2_DISPATCH
+    #endif
+
+    namespace example
+    {
+
+        namespace simd
+        {
+
+            // Vectores de 8 enteros de 32 bits. Todas las variantes exponen la misma interfaz para
+            // que los kernels se escriban una sola vez como plantillas. Las máscaras son vectores
+            // con todos los bits de cada carril a 1 (activo) o a 0 (inactivo).
+
+            struct Int32x8_Scalar
+            {
+                int32_t lane[8];
+
+                static Int32x8_Scalar set1 (int32_t value)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = value;
+                    return result;
+                }
+
+                // Se copia con memcpy porque a veces se cargan los bits de otros tipos (floats del
+                // z-buffer, por ejemplo):
+
+                static Int32x8_Scalar load (const int32_t * values)
+                {
+                    Int32x8_Scalar result;
+                    std::memcpy (result.lane, values, sizeof(result.lane));
+                    return result;
+                }
+
+                void store (int32_t * values) const
+                {
+                    std::memcpy (values, lane, sizeof(lane));
+                }
+
+                friend Int32x8_Scalar operator + (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = int32_t(uint32_t(a.lane[i]) + uint32_t(b.lane[i]));
+                    return result;
+                }
+
+                friend Int32x8_Scalar operator | (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] | b.lane[i];
+                    return result;
+                }
+
+                friend Int32x8_Scalar operator & (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] & b.lane[i];
+                    return result;
+                }
+
+                // Máscara de los carriles con valor negativo:
+
+                static Int32x8_Scalar negative (const Int32x8_Scalar & a)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] < 0 ? -1 : 0;
+                    return result;
+                }
+
+                static Int32x8_Scalar less (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] < b.lane[i] ? -1 : 0;
+                    return result;
+                }
+
+                // ~mask & value:
+
+                static Int32x8_Scalar and_not (const Int32x8_Scalar & mask, const Int32x8_Scalar & value)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = ~mask.lane[i] & value.lane[i];
+                    return result;
+                }
+
+                // Toma los carriles de b donde mask está activa y los de a en el resto:
+
+                static Int32x8_Scalar select (const Int32x8_Scalar & mask, const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = mask.lane[i] ? b.lane[i] : a.lane[i];
+                    return result;
+                }
+
+                static Int32x8_Scalar min (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i];
+                    return result;
+                }
+
+                static Int32x8_Scalar max (const Int32x8_Scalar & a, const Int32x8_Scalar & b)
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i];
+                    return result;
+                }
+
+                // Un bit por carril (el bit i corresponde al carril i):
+
+                static unsigned bits (const Int32x8_Scalar & mask)
+                {
+                    unsigned result = 0;
+                    for (int i = 0; i < 8; ++i) result |= unsigned(mask.lane[i] < 0) << i;
+                    return result;
+                }
+            };
+
+            // Vectores de 8 floats con la misma filosofía. min() y max() devuelven el segundo
+            // operando cuando el primero es NaN, igual que las instrucciones de SSE y AVX.
+
+            struct Float32x8_Scalar
+            {
+                float lane[8];
+
+                static Float32x8_Scalar set1 (float value)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = value;
+                    return result;
+                }
+
+                static Float32x8_Scalar load (const float * values)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = values[i];
+                    return result;
+                }
+
+                void store (float * values) const
+                {
+                    for (int i = 0; i < 8; ++i) values[i] = lane[i];
+                }
+
+                friend Float32x8_Scalar operator + (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] + b.lane[i];
+                    return result;
+                }
+
+                friend Float32x8_Scalar operator - (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] - b.lane[i];
+                    return result;
+                }
+
+                friend Float32x8_Scalar operator * (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] * b.lane[i];
+                    return result;
+                }
+
+                friend Float32x8_Scalar operator / (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] / b.lane[i];
+                    return result;
+                }
+
+                static Float32x8_Scalar min (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] < b.lane[i] ? a.lane[i] : b.lane[i];
+                    return result;
+                }
+
+                static Float32x8_Scalar max (const Float32x8_Scalar & a, const Float32x8_Scalar & b)
+                {
+                    Float32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = a.lane[i] > b.lane[i] ? a.lane[i] : b.lane[i];
+                    return result;
+                }
+
+                // Redondeo al entero más cercano (los empates, al par):
+
+                Int32x8_Scalar to_int32 () const
+                {
+                    Int32x8_Scalar result;
+                    for (int i = 0; i < 8; ++i) result.lane[i] = int32_t(std::nearbyint (lane[i]));
+                    return result;
+                }
+
+                // Los mismos bits vistos como enteros:
+
+                Int32x8_Scalar to_bits () const
+                {
+                    Int32x8_Scalar result;
+                    std::memcpy (result.lane, lane, sizeof(lane));
+                    return result;
+                }
+            };
+
+            #ifdef SIMD_SSE2_AVAILABLE
+
+            struct Int32x8_Sse2
+            {
+                __m128i low, high;
+
+                static Int32x8_Sse2 set1 (int32_t value)
+                {
+                    __m128i v = _mm_set1_epi32 (value);
+                    return { v, v };
+                }
+
+                static Int32x8_Sse2 load (const int32_t * values)
+                {
+                    return
+                    {
+                        _mm_loadu_si128 (reinterpret_cast< const __m128i * >(values    )),
+                        _mm_loadu_si128 (reinterpret_cast< const __m128i * >(values + 4))
+                    };
+                }
+
+                void store (int32_t * values) const
+                {
+                    _mm_storeu_si128 (reinterpret_cast< __m128i * >(values    ), low );
+                    _mm_storeu_si128 (reinterpret_cast< __m128i * >(values + 4), high);
+                }
+
+                friend Int32x8_Sse2 operator + (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return { _mm_add_epi32 (a.low, b.low), _mm_add_epi32 (a.high, b.high) };
+                }
+
+                friend Int32x8_Sse2 operator | (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return { _mm_or_si128 (a.low, b.low), _mm_or_si128 (a.high, b.high) };
+                }
+
+                friend Int32x8_Sse2 operator & (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return { _mm_and_si128 (a.low, b.low), _mm_and_si128 (a.high, b.high) };
+                }
+
+                static Int32x8_Sse2 negative (const Int32x8_Sse2 & a)
+                {
+                    return { _mm_srai_epi32 (a.low, 31), _mm_srai_epi32 (a.high, 31) };
+                }
+
+                static Int32x8_Sse2 less (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return { _mm_cmplt_epi32 (a.low, b.low), _mm_cmplt_epi32 (a.high, b.high) };
+                }
+
+                static Int32x8_Sse2 and_not (const Int32x8_Sse2 & mask, const Int32x8_Sse2 & value)
+                {
+                    return { _mm_andnot_si128 (mask.low, value.low), _mm_andnot_si128 (mask.high, value.high) };
+                }
+
+                static Int32x8_Sse2 select (const Int32x8_Sse2 & mask, const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return
+                    {
+                        _mm_or_si128 (_mm_and_si128 (mask.low,  b.low ), _mm_andnot_si128 (mask.low,  a.low )),
+                        _mm_or_si128 (_mm_and_si128 (mask.high, b.high), _mm_andnot_si128 (mask.high, a.high))
+                    };
+                }
+
+                // SSE2 no tiene mínimo ni máximo de enteros de 32 bits:
+
+                static Int32x8_Sse2 min (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return select (less (b, a), a, b);
+                }
+
+                static Int32x8_Sse2 max (const Int32x8_Sse2 & a, const Int32x8_Sse2 & b)
+                {
+                    return select (less (a, b), a, b);
+                }
+
+                static unsigned bits (const Int32x8_Sse2 & mask)
+                {
+                    return unsigned(_mm_movemask_ps (_mm_castsi128_ps (mask.low ))     )
+                         | unsigned(_mm_movemask_ps (_mm_castsi128_ps (mask.high))) << 4;
+                }
+            };
+
+            struct Float32x8_Sse2
+            {
+                __m128 low, high;
+
+                static Float32x8_Sse2 set1 (float value)
+                {
+                    __m128 v = _mm_set1_ps (value);
+                    return { v, v };
+                }
+
+                static Float32x8_Sse2 load (const float * values)
+                {
+                    return { _mm_loadu_ps (values), _mm_loadu_ps (values + 4) };
+                }
+
+                void store (float * values) const
+                {
+                    _mm_storeu_ps (values,     low );
+                    _mm_storeu_ps (values + 4, high);
+                }
+
+                friend Float32x8_Sse2 operator + (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_add_ps (a.low, b.low), _mm_add_ps (a.high, b.high) };
+                }
+
+                friend Float32x8_Sse2 operator - (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_sub_ps (a.low, b.low), _mm_sub_ps (a.high, b.high) };
+                }
+
+                friend Float32x8_Sse2 operator * (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_mul_ps (a.low, b.low), _mm_mul_ps (a.high, b.high) };
+                }
+
+                friend Float32x8_Sse2 operator / (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_div_ps (a.low, b.low), _mm_div_ps (a.high, b.high) };
+                }
+
+                static Float32x8_Sse2 min (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_min_ps (a.low, b.low), _mm_min_ps (a.high, b.high) };
+                }
+
+                static Float32x8_Sse2 max (const Float32x8_Sse2 & a, const Float32x8_Sse2 & b)
+                {
+                    return { _mm_max_ps (a.low, b.low), _mm_max_ps (a.high, b.high) };
+                }
+
+                Int32x8_Sse2 to_int32 () const
+                {
+                    return { _mm_cvtps_epi32 (low), _mm_cvtps_epi32 (high) };
+                }
+
+                Int32x8_Sse2 to_bits () const
+                {
+                    return { _mm_castps_si128 (low), _mm_castps_si128 (high) };
+                }
+            };
+
+            #endif
+
+            #ifdef SIMD_AVX2_DISPATCH
+
+            // Sus métodos se compilan para AVX2 aunque el resto del programa no lo esté, así que
+            // solo se pueden usar desde funciones marcadas con ARGB_AVX2_KERNEL:
+
+            struct Int32x8_Avx2
+            {
+                __m256i value;
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 set1 (int32_t scalar)
+                {
+                    return { _mm256_set1_epi32 (scalar) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 load (const int32_t * values)
+                {
+                    return { _mm256_loadu_si256 (reinterpret_cast< const __m256i * >(values)) };
+                }
+
+                ARGB_AVX2_TARGET void store (int32_t * values) const
+                {
+                    _mm256_storeu_si256 (reinterpret_cast< __m256i * >(values), value);
+                }
+
+                friend ARGB_AVX2_TARGET Int32x8_Avx2 operator + (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_add_epi32 (a.value, b.value) };
+                }
+
+                friend ARGB_AVX2_TARGET Int32x8_Avx2 operator | (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_or_si256 (a.value, b.value) };
+                }
+
+                friend ARGB_AVX2_TARGET Int32x8_Avx2 operator & (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_and_si256 (a.value, b.value) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 negative (const Int32x8_Avx2 & a)
+                {
+                    return { _mm256_srai_epi32 (a.value, 31) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 less (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_cmpgt_epi32 (b.value, a.value) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 and_not (const Int32x8_Avx2 & mask, const Int32x8_Avx2 & value)
+                {
+                    return { _mm256_andnot_si256 (mask.value, value.value) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 select (const Int32x8_Avx2 & mask, const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_blendv_epi8 (a.value, b.value, mask.value) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 min (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_min_epi32 (a.value, b.value) };
+                }
+
+                static ARGB_AVX2_TARGET Int32x8_Avx2 max (const Int32x8_Avx2 & a, const Int32x8_Avx2 & b)
+                {
+                    return { _mm256_max_epi32 (a.value, b.value) };
+                }
+
+                static ARGB_AVX2_TARGET unsigned bits (const Int32x8_Avx2 & mask)
+                {
+                    return unsigned(_mm256_movemask_ps (_mm256_castsi256_ps (mask.value)));
+                }
+            };
+
+            struct Float32x8_Avx2
+            {
+                __m256 value;
+
+                static ARGB_AVX2_TARGET Float32x8_Avx2 set1 (float scalar)
+                {
+                    return { _mm256_set1_ps (scalar) };
+                }
+
+                static ARGB_AVX2_TARGET Float32x8_Avx2 load (const float * values)
+                {
+                    return { _mm256_loadu_ps (values) };
+                }
+
+                ARGB_AVX2_TARGET void store (float * values) const
+                {
+                    _mm256_storeu_ps (values, value);
+                }
+
+                friend ARGB_AVX2_TARGET Float32x8_Avx2 operator + (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_add_ps (a.value, b.value) };
+                }
+
+                friend ARGB_AVX2_TARGET Float32x8_Avx2 operator - (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_sub_ps (a.value, b.value) };
+                }
+
+                friend ARGB_AVX2_TARGET Float32x8_Avx2 operator * (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_mul_ps (a.value, b.value) };
+                }
+
+                friend ARGB_AVX2_TARGET Float32x8_Avx2 operator / (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_div_ps (a.value, b.value) };
+                }
+
+                static ARGB_AVX2_TARGET Float32x8_Avx2 min (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_min_ps (a.value, b.value) };
+                }
+
+                static ARGB_AVX2_TARGET Float32x8_Avx2 max (const Float32x8_Avx2 & a, const Float32x8_Avx2 & b)
+                {
+                    return { _mm256_max_ps (a.value, b.value) };
+                }
+
+                ARGB_AVX2_TARGET Int32x8_Avx2 to_int32 () const
+                {
+                    return { _mm256_cvtps_epi32 (value) };
+                }
+
+                ARGB_AVX2_TARGET Int32x8_Avx2 to_bits () const
+                {
+                    return { _mm256_castps_si256 (value) };
+                }
+            };
+
+            #endif
+
+            // Índice del bit activo de menor peso (mask no puede ser 0):
+
+            inline unsigned count_trailing_zeros (unsigned mask)
+            {
+                #if defined(_MSC_VER)
+                    unsigned long index;
+                    _BitScanForward (&index, mask);
+                    return unsigned(index);
+                #else
+                    return unsigned(__builtin_ctz (mask));
+                #endif
+            }
+
+            // Número de bits activos:
+
+            inline unsigned count_bits (unsigned mask)
+            {
+                mask = mask - ((mask >> 1) & 0x55555555u);
+                mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+                mask = (mask + (mask >> 4)) & 0x0F0F0F0Fu;
+
+                return (mask * 0x01010101u) >> 24;
+            }
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                // Parte AVX2 de average_bytes(). Devuelve cuántos bytes ha procesado:
+
+                ARGB_AVX2_TARGET inline size_t average_bytes_avx2
+                (
+                    uint8_t       * target,
+                    const uint8_t * a,
+                    const uint8_t * b,
+                    const uint8_t * c,
+                    const uint8_t * d,
+                    size_t          count
+                )
+                {
+                    size_t index = 0;
+
+                    for ( ; index + 32 <= count; index += 32)
+                    {
+                        __m256i ab = _mm256_avg_epu8 (_mm256_loadu_si256 ((const __m256i *)(a + index)), _mm256_loadu_si256 ((const __m256i *)(b + index)));
+                        __m256i cd = _mm256_avg_epu8 (_mm256_loadu_si256 ((const __m256i *)(c + index)), _mm256_loadu_si256 ((const __m256i *)(d + index)));
+
+                        _mm256_storeu_si256 ((__m256i *)(target + index), _mm256_avg_epu8 (ab, cd));
+                    }
+
+                    return index;
+                }
+
+            #endif
+
+            // Media de cuatro arrays de bytes, calculada como la media de dos medias (cada una redondeada
+            // hacia arriba, igual que pavgb) para que todas las variantes den el mismo resultado. La
+            // variante se elige según argb::get_cpu_tier():
+
+            inline void average_bytes
+            (
+                uint8_t       * target,
+                const uint8_t * a,
+                const uint8_t * b,
+                const uint8_t * c,
+                const uint8_t * d,
+                size_t          count
+            )
+            {
+                const argb::Cpu_Tier tier  = argb::get_cpu_tier ();
+                size_t               index = 0;
+
+                #if defined(SIMD_AVX2_DISPATCH)
+
+                    if (tier >= argb::Cpu_Tier::AVX2) index = average_bytes_avx2 (target, a, b, c, d, count);
+
+                #endif
+
+                #if defined(SIMD_SSE2_AVAILABLE)
+
+                    if (tier >= argb::Cpu_Tier::SSE2)
+                    {
+                        for ( ; index + 16 <= count; index += 16)
+                        {
+                            __m128i ab = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *)(a + index)), _mm_loadu_si128 ((const __m128i *)(b + index)));
+                            __m128i cd = _mm_avg_epu8 (_mm_loadu_si128 ((const __m128i *)(c + index)), _mm_loadu_si128 ((const __m128i *)(d + index)));
+
+                            _mm_storeu_si128 ((__m128i *)(target + index), _mm_avg_epu8 (ab, cd));
+                        }
+                    }
+
+                #endif
+
+                for ( ; index < count; ++index)
+                {
+                    unsigned ab = (unsigned(a[index]) + b[index] + 1) >> 1;
+                    unsigned cd = (unsigned(c[index]) + d[index] + 1) >> 1;
+
+                    target[index] = uint8_t((ab + cd + 1) >> 1);
+                }
+            }
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                // Parte AVX2 de find_high_bit(). Devuelve el índice del primer valor con el bit 31
+                // activo o, si no lo encuentra, el primero que queda por comprobar:
+
+                ARGB_AVX2_TARGET inline size_t find_high_bit_avx2 (const uint32_t * values, size_t index, size_t end)
+                {
+                    for ( ; index + 8 <= end; index += 8)
+                    {
+                        unsigned mask = unsigned(_mm256_movemask_ps (_mm256_castsi256_ps (_mm256_loadu_si256 ((const __m256i *)(values + index)))));
+
+                        if (mask) return index + count_trailing_zeros (mask);
+                    }
+
+                    return index;
+                }
+
+            #endif
+
+            // Índice del primer valor de [index, end) con el bit 31 activo, o end si no hay ninguno.
+            // Las variantes SIMD comprueban 4 u 8 valores a la vez, lo que permite saltar deprisa
+            // los tramos largos sin ninguno:
+
+            inline size_t find_high_bit (const uint32_t * values, size_t index, size_t end)
+            {
+                const argb::Cpu_Tier tier = argb::get_cpu_tier ();
+
+                #if defined(SIMD_AVX2_DISPATCH)
+
+                    if (tier >= argb::Cpu_Tier::AVX2) index = find_high_bit_avx2 (values, index, end);
+
+                #endif
+
+                #if defined(SIMD_SSE2_AVAILABLE)
+
+                    if (tier >= argb::Cpu_Tier::SSE2)
+                    {
+                        for ( ; index + 4 <= end; index += 4)
+                        {
+                            unsigned mask = unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_loadu_si128 ((const __m128i *)(values + index)))));
+
+                            if (mask) return index + count_trailing_zeros (mask);
+                        }
+                    }
+
+                #endif
+
+                while (index < end && !(values[index] & 0x80000000u)) ++index;
+
+                return index;
+            }
+
+            // Vectores de cada nivel de argb::Cpu_Tier, con los que se instancian los kernels que se
+            // eligen en tiempo de ejecución:
+
+            struct Scalar_Tier
+            {
+                typedef Int32x8_Scalar   Int32x8;
+                typedef Float32x8_Scalar Float32x8;
+            };
+
+            #if defined(SIMD_SSE2_AVAILABLE)
+
+                struct Sse2_Tier
+                {
+                    typedef Int32x8_Sse2   Int32x8;
+                    typedef Float32x8_Sse2 Float32x8;
+                };
+
+            #endif
+
+            #if defined(SIMD_AVX2_DISPATCH)
+
+                struct Avx2_Tier
+                {
+                    typedef Int32x8_Avx2   Int32x8;
+                    typedef Float32x8_Avx2 Float32x8;
+                };
+
+            #endif
+
+            // Variante con la que se compilan los kernels que no se eligen en tiempo de ejecución:
+
+            #if   defined(SIMD_AVX2_AVAILABLE)
+                typedef Int32x8_Avx2     Int32x8;
+                typedef Float32x8_Avx2   Float32x8;
+            #elif defined(SIMD_SSE2_AVAILABLE)
+                typedef Int32x8_Sse2     Int32x8;
+                typedef Float32x8_Sse2   Float32x8;
+            #else
+                typedef Int32x8_Scalar   Int32x8;
+                typedef Float32x8_Scalar Float32x8;
+            #endif
+
+        }
+
+    }
+
+#endif